@@ -4,10 +4,13 @@ TARGET = audiooutput
 QT += multimedia widgets
 
 SUBDIRS       = libqtmixer \
-                example
+                example \
+                autotests
 
 libqtmixer.subdir = qtmixer
 
 example.subdir = example
 example.depends = libqtmixer
 
+autotests.depends = libqtmixer
+
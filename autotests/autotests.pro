@@ -0,0 +1,12 @@
+TEMPLATE = app
+TARGET = qmixerstreamtest
+
+CONFIG += c++11 testcase
+QT += multimedia testlib
+DEFINES += BUILD_QTMIXER_WITH_QMAKE
+
+INCLUDEPATH += ../qtmixer
+LIBS += -L$$OUT_PWD/../qtmixer -l$$qtLibraryTarget(QtMixer)
+unix: QMAKE_RPATHDIR += $$OUT_PWD/../qtmixer
+
+SOURCES = qmixerstreamtest.cpp
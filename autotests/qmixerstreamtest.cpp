@@ -0,0 +1,197 @@
+#include <cmath>
+#include <cstring>
+
+#include <QtTest>
+#include <QAudioFormat>
+
+#include "qmixerstream.h"
+#include "qmixerstreamhandle.h"
+
+// Renders synthetic streams offline and checks the mix sample by sample.
+// The output is native endian float, so that nothing gets lost converting
+// it and the expected values can be computed the way the mixer does.
+class QMixerStreamTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void loopWrap();
+    void loopRegion();
+    void playAt();
+    void gainRamp();
+    void limiterCeiling();
+
+private:
+    enum {
+        SampleRate = 48000
+    };
+
+    static QAudioFormat floatFormat();
+    static QVector<float> samples(const QByteArray &data);
+    static float saw(qint64 frame);
+};
+
+// a 10 ms saw, 480 frames
+static const char ShortSaw[] = "synth:saw?frequency=100&amplitude=0.5&duration=10";
+static const char EndlessSaw[] = "synth:saw?frequency=100&amplitude=0.5&duration=0";
+
+QAudioFormat QMixerStreamTest::floatFormat()
+{
+    QAudioFormat format;
+    format.setSampleRate(SampleRate);
+    format.setChannelCount(1);
+    format.setSampleSize(32);
+    format.setSampleType(QAudioFormat::Float);
+    format.setByteOrder(QSysInfo::ByteOrder == QSysInfo::LittleEndian ? QAudioFormat::LittleEndian
+                                                                      : QAudioFormat::BigEndian);
+    format.setCodec(QStringLiteral("audio/pcm"));
+    return format;
+}
+
+QVector<float> QMixerStreamTest::samples(const QByteArray &data)
+{
+    QVector<float> result(data.size() / int(sizeof(float)));
+    memcpy(result.data(), data.constData(), result.size() * sizeof(float));
+    return result;
+}
+
+// what QSyntheticStream generates for ShortSaw and EndlessSaw
+float QMixerStreamTest::saw(qint64 frame)
+{
+    double phase = 100.0 * double(frame) / SampleRate;
+    phase -= std::floor(phase);
+    return 0.5f * float(2 * phase - 1);
+}
+
+void QMixerStreamTest::loopWrap()
+{
+    QMixerStream mixer(floatFormat());
+    QMixerStreamHandle handle = mixer.openStream(QLatin1String(ShortSaw));
+    QVERIFY(handle.isValid());
+    handle.setLoops(3);
+    handle.play();
+
+    // three times over without a gap, wrapping in the middle of a block
+    QVector<float> expected;
+    for (int i = 0; i < 3 * 480; ++i) {
+        expected << saw(i % 480);
+    }
+    QCOMPARE(samples(mixer.renderOffline()), expected);
+}
+
+void QMixerStreamTest::loopRegion()
+{
+    QMixerStream mixer(floatFormat());
+    QMixerStreamHandle handle = mixer.openStream(QLatin1String(ShortSaw));
+    QVERIFY(handle.isValid());
+    handle.setLoopRegion(100, 300);
+    handle.setLoops(2);
+    handle.play();
+
+    // up to the end of the region, then from its start on to the end
+    QVector<float> expected;
+    for (int i = 0; i < 300; ++i) {
+        expected << saw(i);
+    }
+    for (int i = 100; i < 480; ++i) {
+        expected << saw(i);
+    }
+    QCOMPARE(samples(mixer.renderOffline()), expected);
+}
+
+void QMixerStreamTest::playAt()
+{
+    QMixerStream mixer(floatFormat());
+
+    // the clock runs on while there is nothing to play
+    QCOMPARE(mixer.renderOffline(1000), QByteArray(1000 * int(sizeof(float)), 0));
+    QCOMPARE(mixer.frameClock(), qint64(1000));
+
+    QMixerStreamHandle handle = mixer.openStream(QLatin1String(EndlessSaw));
+    QVERIFY(handle.isValid());
+    handle.playAt(1500);
+
+    // starts 500 frames into the block
+    QVector<float> expected;
+    for (qint64 frame = 1000; frame < 3048; ++frame) {
+        expected << (frame < 1500 ? 0.0f : saw(frame - 1500));
+    }
+    QCOMPARE(samples(mixer.renderOffline(2048)), expected);
+    QCOMPARE(mixer.frameClock(), qint64(3048));
+}
+
+void QMixerStreamTest::gainRamp()
+{
+    QMixerStream mixer(floatFormat());
+    QMixerStreamHandle handle = mixer.openStream(QLatin1String(EndlessSaw));
+    QVERIFY(handle.isValid());
+    handle.play();
+
+    QVector<float> expected;
+    for (int i = 0; i < 1024; ++i) {
+        expected << saw(i);
+    }
+    QCOMPARE(samples(mixer.renderOffline(1024)), expected);
+
+    // ramped over the next block, from one step below the old gain to the new one
+    handle.setGain(0.25f);
+    const float step = (0.25f - 1.0f) / 1024;
+    const QVector<float> ramp = samples(mixer.renderOffline(1024));
+    QCOMPARE(ramp.size(), 1024);
+    QVERIFY(ramp.first() == saw(1024) * (1.0f + step));
+    QVERIFY(ramp.last() == saw(2047) * 0.25f);
+    expected.clear();
+    for (int i = 0; i < 1024; ++i) {
+        expected << saw(1024 + i) * (1.0f + step * (i + 1));
+    }
+    QCOMPARE(ramp, expected);
+
+    // and steady from there
+    expected.clear();
+    for (int i = 0; i < 1024; ++i) {
+        expected << saw(2048 + i) * 0.25f;
+    }
+    QCOMPARE(samples(mixer.renderOffline(1024)), expected);
+}
+
+void QMixerStreamTest::limiterCeiling()
+{
+    // the level the limiter holds the output below, see qmixerlimiter.cpp
+    const float ceiling = 0.966f;
+
+    QMixerStream mixer(floatFormat());
+    mixer.setLimiterEnabled(true);
+    // 2.7 at the peaks; the rising edges of the saw fill the limiter's window
+    const char *const sources[] = {
+        "synth:sine?frequency=440&amplitude=0.9&duration=500",
+        "synth:sine?frequency=440&amplitude=0.9&duration=500",
+        "synth:saw?frequency=440&amplitude=0.9&duration=500"
+    };
+    for (const char *source : sources) {
+        QMixerStreamHandle handle = mixer.openStream(QLatin1String(source));
+        QVERIFY(handle.isValid());
+        handle.play();
+    }
+
+    const QVector<float> out = samples(mixer.renderOffline());
+    // the lookahead delays the end of the mix, which still has to come out
+    const int end = SampleRate / 2;
+    const int lookahead = SampleRate * mixer.limiterLookahead() / 1000;
+    QVERIFY(out.size() >= end + lookahead);
+
+    float peak = 0.0f;
+    bool tail = false;
+    for (int i = 0; i < out.size(); ++i) {
+        QVERIFY2(std::fabs(out.at(i)) <= ceiling,
+                 qPrintable(QStringLiteral("%1 at frame %2").arg(out.at(i)).arg(i)));
+        peak = qMax(peak, std::fabs(out.at(i)));
+        tail = tail || (i >= end && out.at(i) != 0.0f);
+    }
+    // limited rather than turned down
+    QVERIFY(peak > 0.9f);
+    QVERIFY(tail);
+}
+
+QTEST_GUILESS_MAIN(QMixerStreamTest)
+
+#include "qmixerstreamtest.moc"
@@ -392,8 +392,8 @@ void AudioTest::playFile()
     if (m_fileName.isEmpty()) {
         m_fileName = QFileDialog::getOpenFileName(this, tr("Choose Audio File"));
         if (!m_fileName.isEmpty()) {
-            QAudioFormat audioFormat = m_device.preferredFormat();
-            audioFormat.setSampleSize(16);
+            // QMixerStream mixes in the device's own format, whatever it is
+            const QAudioFormat audioFormat = m_device.preferredFormat();
             if (m_audioOutput) {
                 m_audioOutput->deleteLater();
             }
@@ -1,3 +1,222 @@
+#include <QDebug>
+
 #include "qabstractmixerstream.h"
+#include "qmixerstream_p.h"
+
+QAbstractMixerStream::QAbstractMixerStream()
+    : m_mixer(nullptr)
+    , m_voice(-1)
+    , m_bus(0)
+    , m_routedBus(0)
+    , m_gain(qMixerFloatBits(1.0f))
+    , m_pan(qMixerFloatBits(0.0f))
+    , m_peakLevel(0)
+    , m_rmsLevel(0)
+    , m_priority(0)
+    , m_ready(0)
+    , m_loopStart(0)
+    , m_loopEnd(-1)
+    , m_removed(0)
+{
+
+}
+
+qint64 QAbstractMixerStream::render(char *data, qint64 maxlen)
+{
+    if (state() != QtMixer::Playing) {
+        return 0;
+    }
+
+    return readData(data, maxlen);
+}
+
+float QAbstractMixerStream::gain() const
+{
+    return qMixerBitsFloat(m_gain.loadAcquire());
+}
+
+float QAbstractMixerStream::pan() const
+{
+    return qMixerBitsFloat(m_pan.loadAcquire());
+}
+
+float QAbstractMixerStream::peakLevel() const
+{
+    return qMixerBitsFloat(m_peakLevel.loadAcquire());
+}
+
+float QAbstractMixerStream::rmsLevel() const
+{
+    return qMixerBitsFloat(m_rmsLevel.loadAcquire());
+}
+
+int QAbstractMixerStream::priority() const
+{
+    return m_priority.loadAcquire();
+}
+
+int QAbstractMixerStream::sampleRate() const
+{
+    return m_mixer ? m_mixer->m_format.sampleRate() : 0;
+}
+
+qint64 QAbstractMixerStream::framePosition() const
+{
+    const int position = this->position();
+    return position >= 0 && sampleRate() ? qint64(position) * sampleRate() / 1000 : -1;
+}
+
+void QAbstractMixerStream::setFramePosition(qint64 frame)
+{
+    if (sampleRate()) {
+        setPosition(int(frame * 1000 / sampleRate()));
+    }
+}
+
+qint64 QAbstractMixerStream::frameLength()
+{
+    const int length = this->length();
+    return length >= 0 && sampleRate() ? qint64(length) * sampleRate() / 1000 : -1;
+}
+
+qint64 QAbstractMixerStream::loopStart() const
+{
+    return m_loopStart.loadAcquire();
+}
+
+qint64 QAbstractMixerStream::loopEnd() const
+{
+    return m_loopEnd.loadAcquire();
+}
+
+qint64 QAbstractMixerStream::loopWrapFrame(qint64 frame, qint64 length, bool looping) const
+{
+    if (!looping) {
+        return -1;
+    }
+    qint64 end = m_loopEnd.load();
+    if (length >= 0 && (end < 0 || end > length)) {
+        end = length;
+    }
+    // an empty region, or we were sent past it
+    if (end <= m_loopStart.load() || frame > end) {
+        return -1;
+    }
+    return end;
+}
+
+bool QAbstractMixerStream::hasPreroll(qint64 preroll) const
+{
+    Q_UNUSED(preroll);
+
+    return done();
+}
+
+void QAbstractMixerStream::pollDecoder()
+{
+}
+
+qint64 QAbstractMixerStream::decodeBacklog() const
+{
+    return -1;
+}
+
+bool QAbstractMixerStream::isReady() const
+{
+    return m_ready.loadAcquire();
+}
+
+// Called on our own thread whenever the decoder made progress; emits ready()
+// once, the first time the pre-roll is there
+void QAbstractMixerStream::updateReady()
+{
+    if (m_ready.loadAcquire() || state() == QtMixer::Unknown) {
+        return;
+    }
+    const qint64 preroll = m_mixer ? m_mixer->m_prerollBytes.load() : 0;
+    if (hasPreroll(preroll)) {
+        m_ready.storeRelease(1);
+        emit ready(QMixerStreamHandle(this));
+    }
+}
+
+bool QAbstractMixerStream::post(QMixerCommand command)
+{
+    command.stream = this;
+
+    if (m_removed.loadAcquire()) {
+        qWarning() << Q_FUNC_INFO << "dropping command" << command.type << "for closed stream" << this;
+        return false;
+    }
+    if (!m_mixer) {
+        execute(command);
+    } else if (!m_mixer->post(command)) {
+        qWarning() << Q_FUNC_INFO << "command queue full, dropping command" << command.type << "for" << this;
+        return false;
+    }
+    return true;
+}
+
+bool QAbstractMixerStream::remove()
+{
+    if (!post({QMixerCommand::Remove, this, 0, 0, 0, nullptr, nullptr, nullptr})) {
+        return false;
+    }
+    m_removed.storeRelease(1);
+    return true;
+}
+
+void QAbstractMixerStream::execute(const QMixerCommand &command)
+{
+    switch (command.type) {
+    case QMixerCommand::Play:
+        play();
+        break;
+    case QMixerCommand::Pause:
+        pause();
+        break;
+    case QMixerCommand::Stop:
+        stop();
+        break;
+    case QMixerCommand::Seek:
+        setPosition(int(command.value));
+        break;
+    case QMixerCommand::SeekFrame:
+        setFramePosition(command.value);
+        break;
+    case QMixerCommand::SetLoops:
+        setLoops(int(command.value));
+        break;
+    case QMixerCommand::SetLoopRegion:
+        m_loopStart.storeRelease(qMax<qint64>(0, command.value));
+        m_loopEnd.storeRelease(command.end < 0 ? -1 : command.end);
+        break;
+    case QMixerCommand::SetGain:
+        m_gain.storeRelease(qMixerFloatBits(command.gain));
+        break;
+    case QMixerCommand::SetPan:
+        m_pan.storeRelease(qMixerFloatBits(qBound(-1.0f, command.gain, 1.0f)));
+        break;
+    case QMixerCommand::SetBus:
+        m_bus = int(command.value);
+        break;
+    case QMixerCommand::SetPriority:
+        m_priority.storeRelease(int(command.value));
+        break;
+    case QMixerCommand::Add:
+    case QMixerCommand::Remove:
+    case QMixerCommand::PlayAt:
+    case QMixerCommand::StopAt:
+    case QMixerCommand::AddBus:
+    case QMixerCommand::RemoveBus:
+    case QMixerCommand::SetBusGain:
+    case QMixerCommand::SetBusMuted:
+    case QMixerCommand::SetBusInsert:
+    case QMixerCommand::SetLimiter:
+    case QMixerCommand::ResetStatistics:
+        // mixer bookkeeping, see QMixerStreamPrivate::processCommands()
+        break;
+    }
+}
 
 #include "moc_qabstractmixerstream.cpp"
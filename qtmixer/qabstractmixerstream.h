@@ -2,17 +2,25 @@
 #define QABSTRACTMIXERSTREAM_H
 
 #include <QIODevice>
+#include <QAtomicInteger>
 
 #include "qtmixer.h"
 #include "qmixerstreamhandle.h"
 
+class QMixerStreamPrivate;
+struct QMixerCommand;
+
 class QTMIXER_EXPORT QAbstractMixerStream : public QIODevice
 {
     Q_OBJECT
 
     friend class QMixerStream;
+    friend class QMixerStreamPrivate;
+    friend class QMixerStreamHandle;
 
 public:
+    QAbstractMixerStream();
+
     virtual void play() = 0;
     virtual void pause() = 0;
     virtual void stop() = 0;
@@ -29,16 +37,102 @@ public:
 
     virtual int length() = 0;
 
+    // The position and length in frames of the mixer format, the exact
+    // counterparts of position() and length(); -1 when unknown. By default
+    // they are derived from the millisecond versions, for streams that only
+    // implement those.
+    virtual qint64 framePosition() const;
+    virtual void setFramePosition(qint64 frame);
+    virtual qint64 frameLength();
+
+    // Render up to maxlen bytes of audio in the mixer format into the caller-owned
+    // buffer data, in a single call. Returns the number of bytes actually produced,
+    // which is 0 when the stream isn't playing; the rest of the buffer is left untouched.
+    virtual qint64 render(char *data, qint64 maxlen);
+
+    // the linear gain the mixer applies to this stream, 1 by default
+    float gain() const;
+    // the stereo position from -1 (left) to 1 (right), 0 by default
+    float pan() const;
+    // see QtMixer::StealPolicy; 0 by default
+    int priority() const;
+
+    // The level of the stream in the last block mixed, at its gain but before
+    // panning: the largest sample magnitude and the RMS, 1 being full scale.
+    // 0 while it isn't producing audio.
+    float peakLevel() const;
+    float rmsLevel() const;
+
+    // The part of the stream that is repeated while loops() aren't used up,
+    // in frames; the end is exclusive, -1 meaning the end of the stream.
+    // Playback starts from the current position, wraps from the end of the
+    // region back to its start without a gap, and plays on past the region
+    // after the last loop. The whole stream by default.
+    qint64 loopStart() const;
+    qint64 loopEnd() const;
+
+    // Whether at least preroll bytes of audio past the current position are
+    // decoded, or all of it if there is less. By default only once done().
+    virtual bool hasPreroll(qint64 preroll) const;
+    // Called by the mixing thread while it waits for hasPreroll(), for streams
+    // whose decoding needs the reading side to take part, e.g. to finish a
+    // seek. Does nothing by default.
+    virtual void pollDecoder();
+    // The decoded frames ready past the current position, -1 (the default)
+    // for streams that don't decode ahead; see QMixerStream::statistics()
+    virtual qint64 decodeBacklog() const;
+
+    // set once the mixer's pre-roll was decoded, see QMixerStream::prerollDuration()
+    bool isReady() const;
+
+protected:
+    // for the signals of streams implemented outside the library
+    QMixerStreamHandle handle() { return QMixerStreamHandle(this); }
+
+    // For render(): the frame at which a stream of length frames (-1 if not
+    // known yet) that got to frame has to wrap back to loopStart(), or -1 if
+    // it doesn't. looping tells whether there are loops left.
+    qint64 loopWrapFrame(qint64 frame, qint64 length, bool looping) const;
+
 private:
-    void removeFrom(QList<QAbstractMixerStream *> &streams)
-    {
-        streams.removeAll(this);
-    }
+    // Control requests go through the mixer's command queue and are carried
+    // out by the thread doing the mixing, at the start of its next block;
+    // a stream that isn't attached to a mixer executes them right away.
+    // Returns false when the queue is full and the command was dropped.
+    bool post(QMixerCommand command);
+    // Hands the stream to the mixing thread, which stops and deletes it;
+    // whatever is posted for it afterwards is dropped. False if the queue is full.
+    bool remove();
+    void execute(const QMixerCommand &command);
+    Q_INVOKABLE void updateReady();
+    int sampleRate() const;
+
+    QMixerStreamPrivate *m_mixer;
+    // our index in the mixer's voice array, -1 when not being mixed;
+    // only touched by the mixing thread
+    int m_voice;
+    // the submix bus we are mixed into, as seen by the mixing thread
+    // and by the control side
+    int m_bus;
+    int m_routedBus;
+    // float bits, only written by the mixing thread
+    QAtomicInteger<quint32> m_gain;
+    QAtomicInteger<quint32> m_pan;
+    QAtomicInteger<quint32> m_peakLevel;
+    QAtomicInteger<quint32> m_rmsLevel;
+    QAtomicInt m_priority;
+    QAtomicInt m_ready;
+    // only written by the mixing thread
+    QAtomicInteger<qint64> m_loopStart;
+    QAtomicInteger<qint64> m_loopEnd;
+    // set once the stream was closed, the object is about to go
+    QAtomicInt m_removed;
 
 Q_SIGNALS:
     void stateChanged(QMixerStreamHandle handle, QtMixer::State state);
     void decodingError(QMixerStreamHandle handle, int error, const QString &errorString);
     void decodingFinished(QMixerStreamHandle handle);
+    void ready(QMixerStreamHandle handle);
 };
 
 #endif // QABSTRACTMIXERSTREAM_H
@@ -1,17 +1,21 @@
 #include <QDebug>
 #include <QFileInfo>
+#include <QTimer>
 
 #include "qaudiodecoderstream.h"
+#include "qmixerstreamdecoder_p.h"
 #include "qmixerstreamhandle.h"
 
-QAudioDecoderStream::QAudioDecoderStream(const QString &fileName, const QAudioFormat &format)
-    : m_file(fileName)
-    , m_input(&m_data)
-    , m_output(&m_data)
+QAudioDecoderStream::QAudioDecoderStream(const QString &fileName, const QAudioFormat &format,
+                                         QtMixer::DecodeMode mode, int streamingBufferDuration)
+    : m_streamDecoder(nullptr)
     , m_format(format)
+    , m_mode(mode)
     , m_state(QtMixer::Stopped)
     , m_loops(0)
     , m_remainingLoops(0)
+    , m_position(0)
+    , m_seekTarget(-1)
 {
     QFileInfo finfo(fileName);
 
@@ -23,59 +27,141 @@ QAudioDecoderStream::QAudioDecoderStream(const QString &fileName, const QAudioFo
 
     setOpenMode(QIODevice::ReadOnly);
 
-    const bool valid =
-        m_file.open(QIODevice::ReadOnly) &&
-        m_output.open(QIODevice::ReadOnly) &&
-        m_input.open(QIODevice::WriteOnly);
-
-    if (valid) {
-        m_bufferSize = finfo.size();
-        m_data.reserve(m_bufferSize);
-        m_currentLength = 0;
-
-        m_decoder.setNotifyInterval(10);
-        m_decoder.setAudioFormat(format);
-        m_decoder.setSourceDevice(&m_file);
-        m_decoder.start();
-
-        if (!m_decoder.error()) {
-            connect(&m_decoder, &QAudioDecoder::bufferReady, this, &QAudioDecoderStream::bufferReady);
-            connect(&m_decoder, static_cast<void(QAudioDecoder::*)(QAudioDecoder::Error)>(&QAudioDecoder::error),
-                    this, &QAudioDecoderStream::error);
-            connect(&m_decoder, &QAudioDecoder::finished, this, &QAudioDecoderStream::finished);
-        } else {
-            qCritical() << "Decoder error" << m_decoder.errorString() << "in QAudioDecoderStream";
-            m_decoder.stop();
+    if (m_mode == QtMixer::CachedDecode) {
+        // all the voices playing the same file share one decoded copy of it
+        m_sample = QMixerSampleBank::sample(fileName, format);
+        if (!m_sample->isValid()) {
             m_state = QtMixer::Unknown;
+            return;
         }
-    } else {
+
+        connect(m_sample.data(), &QMixerSample::dataAdded, this, &QIODevice::readyRead);
+        if (m_sample->isComplete()) {
+            // decoded for another voice already, or failed to; still tell our user
+            QTimer::singleShot(0, this, [this]() {
+                if (m_sample->hasError()) {
+                    emit decodingError(this, m_sample->decodeError(), m_sample->errorString());
+                } else {
+                    emit decodingFinished(this);
+                }
+            });
+        } else {
+            connect(m_sample.data(), &QMixerSample::error, this, [this](int error, const QString &errorString) {
+                emit decodingError(this, error, errorString);
+            });
+            connect(m_sample.data(), &QMixerSample::finished, this, [this]() {
+                emit decodingFinished(this);
+            });
+        }
+        return;
+    }
+
+    m_streamDecoder = new QMixerStreamDecoder(fileName, format, streamingBufferDuration);
+    if (!m_streamDecoder->isValid()) {
+        delete m_streamDecoder;
+        m_streamDecoder = nullptr;
         m_state = QtMixer::Unknown;
-        qCritical() << "File or buffer initialisation failure in QAudioDecoderStream";
+        return;
+    }
+
+    connect(m_streamDecoder, &QMixerStreamDecoder::dataAdded, this, &QIODevice::readyRead);
+    connect(m_streamDecoder, &QMixerStreamDecoder::error, this, [this](int error, const QString &errorString) {
+        emit decodingError(this, error, errorString);
+    });
+    connect(m_streamDecoder, &QMixerStreamDecoder::finished, this, [this]() {
+        emit decodingFinished(this);
+    });
+}
+
+QAudioDecoderStream::~QAudioDecoderStream()
+{
+    if (m_streamDecoder) {
+        // it may be busy on its own thread, let that thread delete it
+        m_streamDecoder->deleteLater();
     }
 }
 
 qint64 QAudioDecoderStream::readData(char *data, qint64 maxlen)
 {
-    memset(data, 0, maxlen);
+    if (m_streamDecoder) {
+        m_streamDecoder->flushIfSeeking();
+    }
+    if (m_state != QtMixer::Playing) {
+        memset(data, 0, maxlen);
+        return maxlen;
+    }
 
-    if (m_state == QtMixer::Playing) {
-        maxlen = m_output.read(data, maxlen);
+    const qint64 n = render(data, maxlen);
+    memset(data + n, 0, maxlen - n);
 
-        if (m_output.size() &&
-                m_output.atEnd()) {
-            if (m_loops != 0) {
+    return n;
+}
+
+qint64 QAudioDecoderStream::render(char *data, qint64 maxlen)
+{
+    if (m_mode == QtMixer::StreamingDecode) {
+        return renderStreamed(data, maxlen);
+    }
+
+    qint64 n = 0;
+
+    if (m_state == QtMixer::Playing && settleSeek()) {
+        const int frameBytes = bytesPerFrame();
+        qint64 position = m_position.load();
+        while (n < maxlen) {
+            // the length isn't known until the decoder is done
+            const qint64 length = m_sample->isComplete() ? m_sample->size() / frameBytes : -1;
+            const qint64 wrap = loopWrapFrame(position / frameBytes, length,
+                                              m_loops < 0 || m_remainingLoops > 1);
+            qint64 limit = maxlen - n;
+            if (wrap >= 0) {
+                limit = qMin(limit, wrap * frameBytes - position);
+            }
+            const qint64 read = m_sample->read(position, data + n, limit);
+            position += read;
+            n += read;
+
+            if (wrap >= 0 && position == wrap * frameBytes) {
+                // carry on from the loop start within the same block
+                position = loopStart() * frameBytes;
                 if (m_loops > 0) {
-                    if ((--m_remainingLoops) > 0) {
-                        rewind();
-                    }
-                } else {
-                    rewind();
+                    --m_remainingLoops;
                 }
+            } else if (read < limit || !read) {
+                // at the end, or the decoder has yet to catch up
+                break;
             }
         }
+        m_position.storeRelease(position);
     }
 
-    return maxlen;
+    return n;
+}
+
+qint64 QAudioDecoderStream::renderStreamed(char *data, qint64 maxlen)
+{
+    m_streamDecoder->flushIfSeeking();
+    if (m_state != QtMixer::Playing) {
+        return 0;
+    }
+
+    const qint64 n = m_streamDecoder->read(data, maxlen);
+    qint64 position = m_position.load() + n;
+    const qint64 length = m_streamDecoder->length();
+    if (m_streamDecoder->isLengthKnown() && length > 0) {
+        // the ring holds the start of the next loop already, if there is
+        // one; after the last the position stays at the end
+        while (position >= length && (m_loops < 0 || m_remainingLoops > 1)) {
+            position -= length;
+            if (m_loops > 0) {
+                --m_remainingLoops;
+            }
+        }
+        position = qMin(position, length);
+    }
+    m_position.storeRelease(position);
+
+    return n;
 }
 
 qint64 QAudioDecoderStream::writeData(const char *data, qint64 len)
@@ -89,59 +175,102 @@ qint64 QAudioDecoderStream::writeData(const char *data, qint64 len)
 void QAudioDecoderStream::rewind()
 {
     if (m_state != QtMixer::Unknown) {
-        m_output.seek(0);
+        m_seekTarget.storeRelease(-1);
+        m_position.storeRelease(0);
     }
 }
 
-void QAudioDecoderStream::bufferReady()
+// Moves on to the seek target once the decoder got that far, or to the end
+// if the file turned out shorter; false while it still has to get there
+bool QAudioDecoderStream::settleSeek()
 {
-    if (m_state != QtMixer::Unknown) {
-        const QAudioBuffer &buffer = m_decoder.read();
-
-        const int length = buffer.byteCount();
-        const char *data = buffer.data<char>();
-
-        m_currentLength += length;
-        if (m_currentLength > m_bufferSize) {
-            m_bufferSize *= 2;
-            m_data.resize(m_bufferSize);
-        }
-
-        m_input.write(data, length);
-        emit readyRead();
+    const qint64 target = m_seekTarget.load();
+    if (target < 0) {
+        return true;
+    }
+    // the size is final once complete, so check that first
+    const bool complete = m_sample->isComplete();
+    const qint64 decoded = m_sample->size() / bytesPerFrame() * bytesPerFrame();
+    if (target > decoded && !complete) {
+        return false;
     }
+    m_position.storeRelease(qMin(target, decoded));
+    m_seekTarget.storeRelease(-1);
+    return true;
 }
 
-void QAudioDecoderStream::error(QAudioDecoder::Error error)
+// the play position in bytes, or where a waiting seek is going to
+qint64 QAudioDecoderStream::targetPosition() const
 {
-    qDebug() << Q_FUNC_INFO << m_decoder.errorString();
-    emit decodingError(this, error, m_decoder.errorString());
+    const qint64 target = m_seekTarget.loadAcquire();
+    return target >= 0 ? target : m_position.loadAcquire();
 }
 
-void QAudioDecoderStream::finished()
+void QAudioDecoderStream::requestSeek(qint64 target)
 {
-    m_input.close();
-    qWarning() << "Decoding done; reserved,actual bufSize=" << m_bufferSize << m_data.size()
-        << "m_input,m_output len=" << m_input.size() << m_output.size()
-        << "m_input,m_output pos=" << m_input.pos() << m_output.pos()
-        << "format:" << m_decoder.audioFormat();
-    emit decodingFinished(this);
+    // the decoder plays all the loops again from there
+    m_remainingLoops = m_loops;
+    m_position.storeRelease(target);
+    m_streamDecoder->seek(target);
 }
 
 bool QAudioDecoderStream::atEnd() const
 {
+    if (m_mode == QtMixer::StreamingDecode) {
+        return m_state == QtMixer::Unknown || m_streamDecoder->atEnd();
+    }
+
     if (m_state != QtMixer::Unknown) {
-        return m_output.size()
-               && m_output.atEnd();
+        // the mixer may catch up with the decoder, that's not the end yet
+        return m_sample->isComplete() && m_seekTarget.loadAcquire() < 0
+               && m_position.loadAcquire() >= m_sample->size();
     } else {
         return true;
     }
 }
 
+bool QAudioDecoderStream::hasPreroll(qint64 preroll) const
+{
+    if (m_state == QtMixer::Unknown) {
+        return false;
+    }
+    if (m_mode == QtMixer::StreamingDecode) {
+        // the ring may be smaller than the pre-roll; once the decoder is
+        // done (for all the loops) the rest of the file is in there. Nothing
+        // is until a seek, such as the one stop() makes, is through.
+        return !m_streamDecoder->isSeeking()
+               && (m_streamDecoder->available() >= qMin<qint64>(preroll, m_streamDecoder->capacity())
+                   || !m_streamDecoder->isDecoding());
+    }
+    return m_sample->isComplete()
+           || m_sample->size() - targetPosition() >= preroll;
+}
+
+void QAudioDecoderStream::pollDecoder()
+{
+    if (m_streamDecoder) {
+        m_streamDecoder->flushIfSeeking();
+    }
+}
+
+qint64 QAudioDecoderStream::decodeBacklog() const
+{
+    if (m_state == QtMixer::Unknown || !m_format.isValid()) {
+        return -1;
+    }
+    if (m_mode == QtMixer::StreamingDecode) {
+        return m_streamDecoder->available() / bytesPerFrame();
+    }
+    return qMax<qint64>(0, m_sample->size() - targetPosition()) / bytesPerFrame();
+}
+
 bool QAudioDecoderStream::done() const
 {
-    return m_state != QtMixer::Unknown && m_output.size()
-           && m_decoder.state() != QAudioDecoder::DecodingState;
+    if (m_mode == QtMixer::StreamingDecode) {
+        return m_streamDecoder && m_streamDecoder->isLengthKnown();
+    }
+    return m_state != QtMixer::Unknown && m_sample->size()
+           && m_sample->isComplete();
 }
 
 void QAudioDecoderStream::play()
@@ -149,7 +278,7 @@ void QAudioDecoderStream::play()
     if (m_state != QtMixer::Unknown) {
         m_state = QtMixer::Playing;
 
-        emit stateChanged(this, m_state);
+        emit stateChanged(this, state());
     }
 }
 
@@ -158,29 +287,30 @@ void QAudioDecoderStream::pause()
     if (m_state == QtMixer::Playing) {
         m_state = QtMixer::Paused;
 
-        emit stateChanged(this, m_state);
+        emit stateChanged(this, state());
     }
 }
 
 void QAudioDecoderStream::stop()
 {
     if (m_state != QtMixer::Unknown && m_state != QtMixer::Stopped) {
-        qDebug() << Q_FUNC_INFO << "reserved,actual bufSize=" << m_bufferSize << m_data.size()
-            << "m_input,m_output len=" << m_input.size() << m_output.size()
-            << "m_input,m_output pos=" << m_input.pos() << m_output.pos() << position()
-            << "m_output.atEnd=" << m_output.atEnd();
-        m_state = QtMixer::Stopped;
-        m_remainingLoops = m_loops;
+        if (m_mode == QtMixer::StreamingDecode) {
+            m_state = QtMixer::Stopped;
+            requestSeek(0);
+        } else {
+            m_state = QtMixer::Stopped;
+            m_remainingLoops = m_loops;
 
-        rewind();
+            rewind();
+        }
 
-        emit stateChanged(this, m_state);
+        emit stateChanged(this, state());
     }
 }
 
 QtMixer::State QAudioDecoderStream::state() const
 {
-    return m_state;
+    return QtMixer::State(m_state.loadAcquire());
 }
 
 int QAudioDecoderStream::loops() const
@@ -192,39 +322,71 @@ void QAudioDecoderStream::setLoops(int loops)
 {
     m_loops = loops;
     m_remainingLoops = loops;
+    if (m_streamDecoder) {
+        m_streamDecoder->setLoops(loops);
+    }
+}
+
+int QAudioDecoderStream::bytesPerFrame() const
+{
+    return m_format.sampleSize() / 8 * m_format.channelCount();
 }
 
 int QAudioDecoderStream::position() const
+{
+    const qint64 frame = framePosition();
+    return frame >= 0 ? int(frame * 1000 / m_format.sampleRate()) : -1;
+}
+
+void QAudioDecoderStream::setPosition(int position)
+{
+    if (m_format.isValid()) {
+        setFramePosition(qint64(position) * m_format.sampleRate() / 1000);
+    }
+}
+
+int QAudioDecoderStream::length()
+{
+    const qint64 frames = frameLength();
+    return frames >= 0 ? int(frames * 1000 / m_format.sampleRate()) : -1;
+}
+
+qint64 QAudioDecoderStream::framePosition() const
 {
     if (m_state != QtMixer::Unknown && m_format.isValid()) {
-        return m_output.pos()
-           / (m_format.sampleSize() / 8)
-           / (m_format.sampleRate() / 1000)
-           / (m_format.channelCount());
+        return (m_sample ? targetPosition() : m_position.loadAcquire()) / bytesPerFrame();
     } else {
         return -1;
     }
 }
 
-void QAudioDecoderStream::setPosition(int position)
+void QAudioDecoderStream::setFramePosition(qint64 frame)
 {
     if (m_state != QtMixer::Unknown && m_format.isValid()) {
-        const int target = position
-                       * (m_format.sampleSize() / 8)
-                       * (m_format.sampleRate() / 1000)
-                       * (m_format.channelCount());
-        m_output.seek(target);
+        // whole frames only, so that the channels stay where they belong
+        const qint64 target = qMax<qint64>(0, frame) * bytesPerFrame();
+        if (m_mode == QtMixer::StreamingDecode) {
+            requestSeek(target);
+            return;
+        }
+        // past what was decoded so far, the seek waits for the decoder
+        // rather than landing short of the target
+        m_seekTarget.storeRelease(target);
+        settleSeek();
     }
 }
 
-int QAudioDecoderStream::length()
+qint64 QAudioDecoderStream::frameLength()
 {
     if (m_state != QtMixer::Unknown && m_format.isValid()) {
-        return m_output.size()
-           / (m_format.sampleSize() / 8)
-           / (m_format.sampleRate() / 1000)
-           / (m_format.channelCount());
+        const qint64 bytes = m_sample ? m_sample->size() : m_streamDecoder->length();
+        return bytes / bytesPerFrame();
     } else {
         return -1;
     }
 }
+
+QtMixer::DecodeMode QAudioDecoderStream::decodeMode() const
+{
+    return m_mode;
+}
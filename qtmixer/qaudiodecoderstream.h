@@ -1,17 +1,23 @@
 #ifndef QAUDIODECODERSTREAM_H
 #define QAUDIODECODERSTREAM_H
 
-#include <QBuffer>
-#include <QAudioDecoder>
 #include <QAudioFormat>
-#include <QFile>
+#include <QSharedPointer>
 
 #include "qabstractmixerstream.h"
+#include "qmixersamplebank_p.h"
+
+class QMixerStreamDecoder;
 
 class QTMIXER_EXPORT  QAudioDecoderStream : public QAbstractMixerStream
 {
 public:
-    QAudioDecoderStream(const QString &fileName, const QAudioFormat &format);
+    // streamingBufferDuration is the amount of decoded audio, in milliseconds,
+    // kept ahead of the play cursor in QtMixer::StreamingDecode mode
+    QAudioDecoderStream(const QString &fileName, const QAudioFormat &format,
+                        QtMixer::DecodeMode mode = QtMixer::CachedDecode,
+                        int streamingBufferDuration = 2000);
+    ~QAudioDecoderStream();
 
     bool atEnd() const override;
     bool done() const override;
@@ -30,28 +36,53 @@ public:
 
     int length() override;
 
+    qint64 framePosition() const override;
+    void setFramePosition(qint64 frame) override;
+    qint64 frameLength() override;
+
+    qint64 render(char *data, qint64 maxlen) override;
+
+    bool hasPreroll(qint64 preroll) const override;
+    void pollDecoder() override;
+    qint64 decodeBacklog() const override;
+
+    QtMixer::DecodeMode decodeMode() const;
+
 protected:
     qint64 readData(char *data, qint64 maxlen) override;
     qint64 writeData(const char *data, qint64 len) override;
 
 private:
     void rewind();
-    void bufferReady();
-    void error(QAudioDecoder::Error error);
-    void finished();
-
-    QFile m_file;
-    QBuffer m_input;
-    QBuffer m_output;
-    QByteArray m_data;
-    QAudioDecoder m_decoder;
+    int bytesPerFrame() const;
+
+    // cached mode
+    bool settleSeek();
+    qint64 targetPosition() const;
+
+    // streaming mode
+    qint64 renderStreamed(char *data, qint64 maxlen);
+    void requestSeek(qint64 target);
+
+    // cached mode: the whole decoded file, shared with the other voices
+    // playing it. The decoder appends to it while the mixing threads read
+    // from it, neither needs a lock.
+    QSharedPointer<QMixerSample> m_sample;
+    // streaming mode: our own decoder, living on a decoding thread
+    QMixerStreamDecoder *m_streamDecoder;
     QAudioFormat m_format;
+    const QtMixer::DecodeMode m_mode;
 
-    QtMixer::State m_state;
+    // state and loops are changed by the mixing thread and read from anywhere
+    QAtomicInt m_state;
 
-    int m_loops;
+    QAtomicInt m_loops;
     int m_remainingLoops;
-    qint64 m_bufferSize, m_currentLength;
+    // the play position in bytes, only ever changed by the mixing thread
+    QAtomicInteger<qint64> m_position;
+    // cached mode: where a seek past what was decoded so far goes once the
+    // decoder gets there, in bytes; -1 if none is waiting
+    QAtomicInteger<qint64> m_seekTarget;
 };
 
 #endif // QAUDIODECODERSTREAM_H
@@ -0,0 +1,138 @@
+#include <algorithm>
+
+#include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+
+#include "qmixerbackend.h"
+#include "qaudiodecoderstream.h"
+#include "qpcmfilestream.h"
+#include "qsyntheticstream.h"
+
+namespace {
+
+class SyntheticBackend : public QMixerBackend
+{
+public:
+    QString name() const override { return QStringLiteral("synthetic"); }
+    int priority() const override { return 200; }
+
+    bool canOpen(const QString &fileName) const override
+    {
+        return fileName.startsWith(QLatin1String("synth:"));
+    }
+
+    QAbstractMixerStream *open(const QString &fileName, const QAudioFormat &format,
+                               QtMixer::DecodeMode, int) override
+    {
+        QSyntheticStream *stream = new QSyntheticStream(fileName, format);
+        if (!stream->isValid()) {
+            delete stream;
+            return nullptr;
+        }
+        return stream;
+    }
+};
+
+class PcmBackend : public QMixerBackend
+{
+public:
+    QString name() const override { return QStringLiteral("pcm"); }
+    int priority() const override { return 100; }
+
+    bool canOpen(const QString &fileName) const override
+    {
+        const QString suffix = QFileInfo(fileName).suffix().toLower();
+        return suffix == QLatin1String("wav")
+               || suffix == QLatin1String("raw")
+               || suffix == QLatin1String("pcm");
+    }
+
+    QAbstractMixerStream *open(const QString &fileName, const QAudioFormat &format,
+                               QtMixer::DecodeMode, int) override
+    {
+        // a mapping is already both streamed and cached, the mode doesn't matter
+        QPcmFileStream *stream = new QPcmFileStream(fileName, format);
+        if (!stream->isValid()) {
+            delete stream;
+            return nullptr;
+        }
+        return stream;
+    }
+};
+
+class AudioDecoderBackend : public QMixerBackend
+{
+public:
+    QString name() const override { return QStringLiteral("qaudiodecoder"); }
+    int priority() const override { return 0; }
+
+    // the last resort; a file it can't play still gives a stream, in the
+    // QtMixer::Unknown state
+    bool canOpen(const QString &) const override { return true; }
+
+    QAbstractMixerStream *open(const QString &fileName, const QAudioFormat &format,
+                               QtMixer::DecodeMode mode, int streamingBufferDuration) override
+    {
+        return new QAudioDecoderStream(fileName, format, mode, streamingBufferDuration);
+    }
+};
+
+struct BackendRegistry
+{
+    BackendRegistry()
+    {
+        backends << new SyntheticBackend << new PcmBackend << new AudioDecoderBackend;
+    }
+
+    ~BackendRegistry()
+    {
+        qDeleteAll(backends);
+    }
+
+    QMutex lock;
+    // by decreasing priority
+    QList<QMixerBackend *> backends;
+};
+
+Q_GLOBAL_STATIC(BackendRegistry, registry)
+
+} // namespace
+
+QMixerBackend::~QMixerBackend()
+{
+
+}
+
+void QMixerBackend::registerBackend(QMixerBackend *backend)
+{
+    QMutexLocker lock(&registry()->lock);
+    QList<QMixerBackend *> &backends = registry()->backends;
+    // after the ones of the same priority, so that the built in backends
+    // keep their place
+    const auto pos = std::upper_bound(backends.begin(), backends.end(), backend,
+                                      [](const QMixerBackend *a, const QMixerBackend *b) {
+        return a->priority() > b->priority();
+    });
+    backends.insert(pos, backend);
+}
+
+QList<QMixerBackend *> QMixerBackend::backends()
+{
+    QMutexLocker lock(&registry()->lock);
+    return registry()->backends;
+}
+
+QAbstractMixerStream *QMixerBackend::createStream(const QString &fileName, const QAudioFormat &format,
+                                                  QtMixer::DecodeMode mode, int streamingBufferDuration)
+{
+    const QList<QMixerBackend *> candidates = backends();
+    for (QMixerBackend *backend : candidates) {
+        if (backend->canOpen(fileName)) {
+            if (QAbstractMixerStream *stream = backend->open(fileName, format, mode, streamingBufferDuration)) {
+                return stream;
+            }
+        }
+    }
+    return nullptr;
+}
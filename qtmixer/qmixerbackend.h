@@ -0,0 +1,45 @@
+#ifndef QMIXERBACKEND_H
+#define QMIXERBACKEND_H
+
+#include <QString>
+#include <QList>
+#include <QAudioFormat>
+
+#include "qtmixer.h"
+
+class QAbstractMixerStream;
+
+// A source of mixer streams for some kind of file. QMixerStream::openStream()
+// asks the registered backends, highest priority first, whether they can open
+// a file, and takes the first stream one of them actually creates.
+// Built in are, by priority:
+//  - "synthetic": generated test signals, for names like
+//    "synth:sine?frequency=440&amplitude=0.5&duration=1000", see QSyntheticStream
+//  - "pcm": WAV and raw PCM files played from a mapping, see QPcmFileStream
+//  - "qaudiodecoder": everything else, through QAudioDecoder
+class QTMIXER_EXPORT QMixerBackend
+{
+public:
+    virtual ~QMixerBackend();
+
+    virtual QString name() const = 0;
+    virtual int priority() const = 0;
+
+    // a cheap check on the name, or a quick probe of the file
+    virtual bool canOpen(const QString &fileName) const = 0;
+    // a stream playing fileName in format, or nullptr if that isn't possible after all.
+    // The stream keeps streamingBufferDuration milliseconds of audio ready
+    // if mode is QtMixer::StreamingDecode and that makes a difference to it.
+    virtual QAbstractMixerStream *open(const QString &fileName, const QAudioFormat &format,
+                                       QtMixer::DecodeMode mode, int streamingBufferDuration) = 0;
+
+    // takes ownership; backends can't be unregistered
+    static void registerBackend(QMixerBackend *backend);
+    static QList<QMixerBackend *> backends();
+
+    // tries the backends in order; nullptr if none could open fileName
+    static QAbstractMixerStream *createStream(const QString &fileName, const QAudioFormat &format,
+                                              QtMixer::DecodeMode mode, int streamingBufferDuration);
+};
+
+#endif // QMIXERBACKEND_H
@@ -0,0 +1,91 @@
+#ifndef QMIXERCOMMANDQUEUE_P_H
+#define QMIXERCOMMANDQUEUE_P_H
+
+#include <QAtomicInteger>
+#include <QScopedArrayPointer>
+
+// Bounded lock-free multi-producer queue (D. Vyukov's design): any number of
+// threads may push(), the mixing thread pops. Every cell carries a sequence
+// number telling whose turn it is, so neither side ever waits for the other;
+// push() simply fails when the queue is full.
+template <typename T>
+class QMixerCommandQueue
+{
+public:
+    // capacity must be a power of two
+    explicit QMixerCommandQueue(quint32 capacity)
+        : m_cells(new Cell[capacity])
+        , m_mask(capacity - 1)
+        , m_enqueuePos(0)
+        , m_dequeuePos(0)
+    {
+        for (quint32 i = 0; i < capacity; ++i) {
+            m_cells[i].sequence.store(i);
+        }
+    }
+
+    bool push(const T &value)
+    {
+        Cell *cell;
+        quint32 pos = m_enqueuePos.load();
+        for (;;) {
+            cell = &m_cells[pos & m_mask];
+            const qint32 diff = qint32(cell->sequence.loadAcquire() - pos);
+            if (diff == 0) {
+                if (m_enqueuePos.testAndSetRelaxed(pos, pos + 1, pos)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = m_enqueuePos.load();
+            }
+        }
+        cell->value = value;
+        cell->sequence.storeRelease(pos + 1);
+        return true;
+    }
+
+    bool pop(T &value)
+    {
+        Cell *cell;
+        quint32 pos = m_dequeuePos.load();
+        for (;;) {
+            cell = &m_cells[pos & m_mask];
+            const qint32 diff = qint32(cell->sequence.loadAcquire() - (pos + 1));
+            if (diff == 0) {
+                if (m_dequeuePos.testAndSetRelaxed(pos, pos + 1, pos)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = m_dequeuePos.load();
+            }
+        }
+        value = cell->value;
+        cell->sequence.storeRelease(pos + m_mask + 1);
+        return true;
+    }
+
+    bool isEmpty() const
+    {
+        return m_enqueuePos.loadAcquire() == m_dequeuePos.loadAcquire();
+    }
+
+private:
+    Q_DISABLE_COPY(QMixerCommandQueue)
+
+    struct Cell
+    {
+        QAtomicInteger<quint32> sequence;
+        T value;
+    };
+
+    QScopedArrayPointer<Cell> m_cells;
+    const quint32 m_mask;
+    QAtomicInteger<quint32> m_enqueuePos;
+    QAtomicInteger<quint32> m_dequeuePos;
+};
+
+#endif // QMIXERCOMMANDQUEUE_P_H
@@ -0,0 +1,65 @@
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <QVector>
+
+#include "qmixerdecodepool_p.h"
+
+namespace {
+
+struct DecodePool
+{
+    DecodePool()
+        : count(qBound(1, QThread::idealThreadCount(), 4))
+        , next(0)
+    {
+    }
+
+    ~DecodePool()
+    {
+        for (QThread *thread : qAsConst(threads)) {
+            thread->quit();
+            thread->wait();
+            delete thread;
+        }
+    }
+
+    QMutex lock;
+    QVector<QThread *> threads;
+    int count;
+    int next;
+};
+
+Q_GLOBAL_STATIC(DecodePool, decodePool)
+
+} // namespace
+
+int QMixerDecodePool::threadCount()
+{
+    QMutexLocker lock(&decodePool()->lock);
+    return decodePool()->count;
+}
+
+void QMixerDecodePool::setThreadCount(int count)
+{
+    QMutexLocker lock(&decodePool()->lock);
+    decodePool()->count = qMax(count, 1);
+}
+
+QThread *QMixerDecodePool::thread()
+{
+    DecodePool *pool = decodePool();
+    QMutexLocker lock(&pool->lock);
+
+    // threads beyond a lowered count just don't get new work
+    const int index = pool->next % pool->count;
+    pool->next = index + 1;
+    while (pool->threads.size() <= index) {
+        QThread *thread = new QThread;
+        thread->setObjectName(QStringLiteral("QtMixer decoder %1").arg(pool->threads.size()));
+        thread->start();
+        pool->threads.append(thread);
+    }
+
+    return pool->threads.at(index);
+}
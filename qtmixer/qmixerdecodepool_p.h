@@ -0,0 +1,22 @@
+#ifndef QMIXERDECODEPOOL_P_H
+#define QMIXERDECODEPOOL_P_H
+
+class QThread;
+
+// The worker threads the decoders run on, so that decoding neither competes
+// with the GUI event loop nor goes one file at a time. Each thread runs an
+// event loop; decoders are moved to them round robin and hand their output
+// to the mixer through lock-free structures (QMixerSampleBuffer, QMixerRingBuffer).
+class QMixerDecodePool
+{
+public:
+    // QThread::idealThreadCount() clamped to [1, 4] by default
+    static int threadCount();
+    // only affects decoders started afterwards
+    static void setThreadCount(int count);
+
+    // the thread to move the next decoder to; started if need be
+    static QThread *thread();
+};
+
+#endif // QMIXERDECODEPOOL_P_H
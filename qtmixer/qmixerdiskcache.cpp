@@ -0,0 +1,207 @@
+#include <algorithm>
+#include <cstring>
+
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+
+#include "qmixerdiskcache_p.h"
+#include "qmixersamplebank_p.h"
+#include "qmixersamplebuffer_p.h"
+
+namespace {
+
+const char Magic[8] = { 'Q', 'M', 'X', 'P', 'C', 'M', '0', '1' };
+
+struct DiskCacheSettings
+{
+    QMutex lock;
+    QString directory;
+    qint64 maximumSize = 256 * 1024 * 1024;
+};
+
+Q_GLOBAL_STATIC(DiskCacheSettings, settings)
+
+// the source file, the version of it we decoded and the target format
+QByteArray entryKey(const QString &fileName, const QAudioFormat &format)
+{
+    const QFileInfo finfo(fileName);
+    return qMixerSampleKey(fileName, format).toUtf8()
+           + '|' + QByteArray::number(finfo.size())
+           + '|' + QByteArray::number(finfo.lastModified().toMSecsSinceEpoch());
+}
+
+QString entryPath(const QString &directory, const QByteArray &key)
+{
+    const QByteArray hash = QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex();
+    return QDir(directory).filePath(QString::fromLatin1(hash) + QStringLiteral(".pcm"));
+}
+
+// magic, data size, key size, key
+qint64 headerSize(const QByteArray &key)
+{
+    return sizeof(Magic) + sizeof(quint64) + sizeof(quint32) + key.size();
+}
+
+// Access times are often not kept (noatime, relatime), so a hit moves the
+// modification time of the entry instead, which eviction goes by. Its
+// contents don't change.
+void touch(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadWrite)) {
+        return;
+    }
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+    file.setFileTime(QDateTime::currentDateTimeUtc(), QFileDevice::FileModificationTime);
+#else
+    // writing the magic over itself does the same
+    file.write(Magic, sizeof(Magic));
+#endif
+}
+
+} // namespace
+
+QString QMixerDiskCache::directory()
+{
+    QMutexLocker lock(&settings()->lock);
+    return settings()->directory;
+}
+
+void QMixerDiskCache::setDirectory(const QString &directory)
+{
+    QMutexLocker lock(&settings()->lock);
+    settings()->directory = directory;
+}
+
+qint64 QMixerDiskCache::maximumSize()
+{
+    QMutexLocker lock(&settings()->lock);
+    return settings()->maximumSize;
+}
+
+void QMixerDiskCache::setMaximumSize(qint64 bytes)
+{
+    QMutexLocker lock(&settings()->lock);
+    settings()->maximumSize = bytes;
+}
+
+const char *QMixerDiskCache::map(const QString &fileName, const QAudioFormat &format,
+                                 QFile &file, qint64 *size)
+{
+    const QString dir = directory();
+    if (dir.isEmpty()) {
+        return nullptr;
+    }
+
+    const QByteArray key = entryKey(fileName, format);
+    file.setFileName(entryPath(dir, key));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return nullptr;
+    }
+
+    const qint64 fileSize = file.size();
+    const qint64 offset = headerSize(key);
+    if (fileSize >= offset) {
+        uchar *mapped = file.map(0, fileSize);
+        if (mapped) {
+            quint64 dataSize;
+            quint32 keySize;
+            memcpy(&dataSize, mapped + sizeof(Magic), sizeof(dataSize));
+            memcpy(&keySize, mapped + sizeof(Magic) + sizeof(dataSize), sizeof(keySize));
+            // a complete entry for this very key, hash collisions included
+            if (!memcmp(mapped, Magic, sizeof(Magic))
+                    && keySize == quint32(key.size())
+                    && !memcmp(mapped + offset - key.size(), key.constData(), key.size())
+                    && dataSize == quint64(fileSize - offset)) {
+                *size = qint64(dataSize);
+                touch(file.fileName());
+                return reinterpret_cast<const char *>(mapped + offset);
+            }
+            file.unmap(mapped);
+        }
+    }
+    file.close();
+
+    return nullptr;
+}
+
+bool QMixerDiskCache::store(const QString &fileName, const QAudioFormat &format,
+                            const QMixerSampleBuffer &data)
+{
+    const QString dir = directory();
+    if (dir.isEmpty() || !data.size() || !QDir().mkpath(dir)) {
+        return false;
+    }
+
+    const QByteArray key = entryKey(fileName, format);
+    const QString path = entryPath(dir, key);
+
+    // QSaveFile writes a temporary file and renames it into place once it is
+    // complete: concurrent writers each write their own copy and the last one
+    // wins, readers only ever see whole entries. Mappings of a replaced entry
+    // stay valid.
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    const quint64 dataSize = quint64(data.size());
+    const quint32 keySize = quint32(key.size());
+    file.write(Magic, sizeof(Magic));
+    file.write(reinterpret_cast<const char *>(&dataSize), sizeof(dataSize));
+    file.write(reinterpret_cast<const char *>(&keySize), sizeof(keySize));
+    file.write(key);
+
+    QByteArray chunk(QMixerSampleBuffer::ChunkSize, Qt::Uninitialized);
+    for (qint64 pos = 0; pos < data.size();) {
+        const qint64 n = data.read(pos, chunk.data(), chunk.size());
+        file.write(chunk.constData(), n);
+        pos += n;
+    }
+
+    if (!file.commit()) {
+        qWarning() << "Couldn't write decode cache entry" << path << "for" << fileName;
+        return false;
+    }
+
+    evict(dir, path);
+    return true;
+}
+
+void QMixerDiskCache::evict(const QString &directory, const QString &keep)
+{
+    QFileInfoList entries = QDir(directory).entryInfoList(QStringList() << QStringLiteral("*.pcm"), QDir::Files);
+
+    qint64 total = 0;
+    for (const QFileInfo &entry : qAsConst(entries)) {
+        total += entry.size();
+    }
+
+    const qint64 budget = maximumSize();
+    if (total <= budget) {
+        return;
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const QFileInfo &a, const QFileInfo &b) {
+        return a.lastModified() < b.lastModified();
+    });
+    const QString kept = QFileInfo(keep).absoluteFilePath();
+    for (const QFileInfo &entry : qAsConst(entries)) {
+        if (total <= budget) {
+            break;
+        }
+        if (entry.absoluteFilePath() != kept) {
+            // another process may have removed it already; either way it's gone.
+            // Voices playing from it keep their mapping.
+            QFile::remove(entry.absoluteFilePath());
+            total -= entry.size();
+        }
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef QMIXERDISKCACHE_P_H
+#define QMIXERDISKCACHE_P_H
+
+#include <QString>
+#include <QFile>
+#include <QAudioFormat>
+
+class QMixerSampleBuffer;
+
+// Optional on-disk cache of decoded files, so that they don't have to be
+// decoded again by the next run. An entry is keyed by the source file, its
+// size and modification time, and the target format; it is a small header
+// followed by the raw PCM, and is played straight from a memory mapping.
+// Entries are written through QSaveFile, so concurrent writers (threads or
+// processes) never produce a partial entry; the least recently used ones are
+// removed when the cache grows beyond its maximum size.
+// The cache files are specific to the machine that wrote them.
+class QMixerDiskCache
+{
+public:
+    // an empty directory, the default, disables the cache
+    static QString directory();
+    static void setDirectory(const QString &directory);
+    static qint64 maximumSize();
+    static void setMaximumSize(qint64 bytes);
+
+    // Maps the cached PCM of fileName in format through file; returns a
+    // pointer to the data and its size, or nullptr if there is no valid entry.
+    static const char *map(const QString &fileName, const QAudioFormat &format,
+                           QFile &file, qint64 *size);
+    static bool store(const QString &fileName, const QAudioFormat &format,
+                      const QMixerSampleBuffer &data);
+
+private:
+    static void evict(const QString &directory, const QString &keep);
+};
+
+#endif // QMIXERDISKCACHE_P_H
@@ -0,0 +1,246 @@
+#include "qmixerformat_p.h"
+#include "qmixerkernels_p.h"
+
+namespace {
+
+template <typename Codec>
+void accumulateSamples(float *bus, const char *src, qint64 count, float gain)
+{
+    const uchar *p = reinterpret_cast<const uchar *>(src);
+    for (qint64 i = 0; i < count; ++i, p += Codec::Size) {
+        bus[i] += Codec::load(p) * gain;
+    }
+}
+
+template <typename Codec>
+void storeSamples(char *dst, const float *bus, qint64 count)
+{
+    uchar *p = reinterpret_cast<uchar *>(dst);
+    for (qint64 i = 0; i < count; ++i, p += Codec::Size) {
+        Codec::store(p, bus[i]);
+    }
+}
+
+template <typename Codec>
+void mixSamples(char *dst, const char *src, qint64 count)
+{
+    uchar *d = reinterpret_cast<uchar *>(dst);
+    const uchar *s = reinterpret_cast<const uchar *>(src);
+    for (qint64 i = 0; i < count; ++i, d += Codec::Size, s += Codec::Size) {
+        Codec::store(d, Codec::load(d) + Codec::load(s));
+    }
+}
+
+template <typename Codec>
+void scaleSamples(char *data, qint64 count, float gain)
+{
+    uchar *p = reinterpret_cast<uchar *>(data);
+    for (qint64 i = 0; i < count; ++i, p += Codec::Size) {
+        Codec::store(p, Codec::load(p) * gain);
+    }
+}
+
+template <typename Codec>
+void accumulateWeightedSamples(float *bus, const char *src, qint64 count, const float *gains)
+{
+    const uchar *p = reinterpret_cast<const uchar *>(src);
+    for (qint64 i = 0; i < count; ++i, p += Codec::Size) {
+        bus[i] += Codec::load(p) * gains[i];
+    }
+}
+
+template <typename Codec>
+void scaleWeightedSamples(char *data, qint64 count, const float *gains)
+{
+    uchar *p = reinterpret_cast<uchar *>(data);
+    for (qint64 i = 0; i < count; ++i, p += Codec::Size) {
+        Codec::store(p, Codec::load(p) * gains[i]);
+    }
+}
+
+template <typename Codec>
+void measureSamples(const char *src, qint64 count, float *peak, float *sumSquares)
+{
+    const uchar *p = reinterpret_cast<const uchar *>(src);
+    float maximum = 0.0f;
+    float sum = 0.0f;
+    for (qint64 i = 0; i < count; ++i, p += Codec::Size) {
+        const float value = Codec::load(p);
+        maximum = qMax(maximum, std::fabs(value));
+        sum += value * value;
+    }
+    *peak = maximum;
+    *sumSquares = sum;
+}
+
+template <typename Codec>
+QMixerFormatKernels formatKernels()
+{
+    QMixerFormatKernels kernels = {
+        Codec::Size,
+        accumulateSamples<Codec>,
+        storeSamples<Codec>,
+        mixSamples<Codec>,
+        scaleSamples<Codec>,
+        accumulateWeightedSamples<Codec>,
+        scaleWeightedSamples<Codec>,
+        measureSamples<Codec>
+    };
+    return kernels;
+}
+
+// native endian S16 is the common case and goes through the SIMD kernels
+void accumulateNativeS16(float *bus, const char *src, qint64 count, float gain)
+{
+    qMixerKernels().accumulateS16(bus, reinterpret_cast<const qint16 *>(src), count, gain);
+}
+
+void storeNativeS16(char *dst, const float *bus, qint64 count)
+{
+    qMixerKernels().convertF32ToS16(reinterpret_cast<qint16 *>(dst), bus, count);
+}
+
+void mixNativeS16(char *dst, const char *src, qint64 count)
+{
+    qMixerKernels().mixS16(reinterpret_cast<qint16 *>(dst), reinterpret_cast<const qint16 *>(src), count);
+}
+
+void scaleNativeS16(char *data, qint64 count, float gain)
+{
+    qMixerKernels().scaleS16(reinterpret_cast<qint16 *>(data), count, gain);
+}
+
+void accumulateWeightedNativeS16(float *bus, const char *src, qint64 count, const float *gains)
+{
+    qMixerKernels().accumulateS16Weighted(bus, reinterpret_cast<const qint16 *>(src), count, gains);
+}
+
+void scaleWeightedNativeS16(char *data, qint64 count, const float *gains)
+{
+    qMixerKernels().scaleS16Weighted(reinterpret_cast<qint16 *>(data), count, gains);
+}
+
+void measureNativeS16(const char *src, qint64 count, float *peak, float *sumSquares)
+{
+    qMixerKernels().measureS16(reinterpret_cast<const qint16 *>(src), count, peak, sumSquares);
+}
+
+// so does native endian float, which needs no conversion; what the kernels
+// don't cover are plain loops over floats, which the compiler vectorizes
+void accumulateNativeF32(float *bus, const char *src, qint64 count, float gain)
+{
+    qMixerKernels().accumulateF32(bus, reinterpret_cast<const float *>(src), count, gain);
+}
+
+void storeNativeF32(char *dst, const float *bus, qint64 count)
+{
+    float *d = reinterpret_cast<float *>(dst);
+    for (qint64 i = 0; i < count; ++i) {
+        d[i] = qBound(-1.0f, bus[i], 1.0f);
+    }
+}
+
+void mixNativeF32(char *dst, const char *src, qint64 count)
+{
+    float *d = reinterpret_cast<float *>(dst);
+    const float *s = reinterpret_cast<const float *>(src);
+    for (qint64 i = 0; i < count; ++i) {
+        d[i] = qBound(-1.0f, d[i] + s[i], 1.0f);
+    }
+}
+
+void scaleNativeF32(char *data, qint64 count, float gain)
+{
+    float *p = reinterpret_cast<float *>(data);
+    for (qint64 i = 0; i < count; ++i) {
+        p[i] = qBound(-1.0f, p[i] * gain, 1.0f);
+    }
+}
+
+void accumulateWeightedNativeF32(float *bus, const char *src, qint64 count, const float *gains)
+{
+    qMixerKernels().accumulateF32Weighted(bus, reinterpret_cast<const float *>(src), count, gains);
+}
+
+void scaleWeightedNativeF32(char *data, qint64 count, const float *gains)
+{
+    float *p = reinterpret_cast<float *>(data);
+    for (qint64 i = 0; i < count; ++i) {
+        p[i] = qBound(-1.0f, p[i] * gains[i], 1.0f);
+    }
+}
+
+void measureNativeF32(const char *src, qint64 count, float *peak, float *sumSquares)
+{
+    qMixerKernels().measureF32(reinterpret_cast<const float *>(src), count, peak, sumSquares);
+}
+
+template <QSysInfo::Endian Order>
+QMixerFormatKernels kernelsForOrder(QAudioFormat::SampleType type, int sampleSize)
+{
+    switch (type) {
+    case QAudioFormat::SignedInt:
+        switch (sampleSize) {
+        case 8:
+            return formatKernels<QMixerSampleCodec<QMixerSignedSample, 1, Order> >();
+        case 16:
+            if (Order == QSysInfo::ByteOrder) {
+                QMixerFormatKernels kernels = {
+                    2, accumulateNativeS16, storeNativeS16, mixNativeS16, scaleNativeS16,
+                    accumulateWeightedNativeS16, scaleWeightedNativeS16, measureNativeS16
+                };
+                return kernels;
+            }
+            return formatKernels<QMixerSampleCodec<QMixerSignedSample, 2, Order> >();
+        case 24:
+            return formatKernels<QMixerSampleCodec<QMixerSignedSample, 3, Order> >();
+        case 32:
+            return formatKernels<QMixerSampleCodec<QMixerSignedSample, 4, Order> >();
+        }
+        break;
+    case QAudioFormat::UnSignedInt:
+        switch (sampleSize) {
+        case 8:
+            return formatKernels<QMixerSampleCodec<QMixerUnsignedSample, 1, Order> >();
+        case 16:
+            return formatKernels<QMixerSampleCodec<QMixerUnsignedSample, 2, Order> >();
+        case 24:
+            return formatKernels<QMixerSampleCodec<QMixerUnsignedSample, 3, Order> >();
+        case 32:
+            return formatKernels<QMixerSampleCodec<QMixerUnsignedSample, 4, Order> >();
+        }
+        break;
+    case QAudioFormat::Float:
+        if (sampleSize == 32) {
+            if (Order == QSysInfo::ByteOrder) {
+                QMixerFormatKernels kernels = {
+                    4, accumulateNativeF32, storeNativeF32, mixNativeF32, scaleNativeF32,
+                    accumulateWeightedNativeF32, scaleWeightedNativeF32, measureNativeF32
+                };
+                return kernels;
+            }
+            return formatKernels<QMixerSampleCodec<QMixerFloatSample, 4, Order> >();
+        }
+        break;
+    default:
+        break;
+    }
+
+    QMixerFormatKernels invalid = { 0, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr };
+    return invalid;
+}
+
+} // namespace
+
+QMixerFormatKernels qMixerFormatKernels(const QAudioFormat &format)
+{
+    if (format.codec() == QLatin1String("audio/pcm")) {
+        if (format.byteOrder() == QAudioFormat::LittleEndian) {
+            return kernelsForOrder<QSysInfo::LittleEndian>(format.sampleType(), format.sampleSize());
+        }
+        return kernelsForOrder<QSysInfo::BigEndian>(format.sampleType(), format.sampleSize());
+    }
+
+    QMixerFormatKernels invalid = { 0, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr };
+    return invalid;
+}
@@ -0,0 +1,133 @@
+#ifndef QMIXERFORMAT_P_H
+#define QMIXERFORMAT_P_H
+
+#include <QtGlobal>
+#include <QSysInfo>
+#include <QAudioFormat>
+
+#include <cmath>
+#include <cstring>
+
+// Compile-time sample codecs: one instantiation per sample type, size and byte
+// order, converting between the stored representation and a float in [-1,1].
+// All the parameters are template arguments, so the per-sample code contains
+// no format tests at all.
+
+enum QMixerSampleKind {
+    QMixerSignedSample,
+    QMixerUnsignedSample,
+    QMixerFloatSample
+};
+
+template <int Bytes, QSysInfo::Endian Order>
+struct QMixerRawSample
+{
+    static quint32 load(const uchar *p)
+    {
+        quint32 value = 0;
+        for (int i = 0; i < Bytes; ++i) {
+            value |= quint32(p[Order == QSysInfo::LittleEndian ? i : Bytes - 1 - i]) << (8 * i);
+        }
+        return value;
+    }
+
+    static void store(uchar *p, quint32 value)
+    {
+        for (int i = 0; i < Bytes; ++i) {
+            p[Order == QSysInfo::LittleEndian ? i : Bytes - 1 - i] = uchar(value >> (8 * i));
+        }
+    }
+};
+
+template <QMixerSampleKind Kind, int Bytes, QSysInfo::Endian Order>
+struct QMixerSampleCodec;
+
+template <int Bytes, QSysInfo::Endian Order>
+struct QMixerSampleCodec<QMixerSignedSample, Bytes, Order>
+{
+    enum { Size = Bytes, Shift = 32 - 8 * Bytes };
+
+    static double fullScale() { return double(quint32(1) << (8 * Bytes - 1)); }
+
+    static float load(const uchar *p)
+    {
+        // sign-extend through the top of a 32 bit word
+        const qint32 value = qint32(QMixerRawSample<Bytes, Order>::load(p) << Shift) >> Shift;
+        return float(value / fullScale());
+    }
+
+    static void store(uchar *p, float value)
+    {
+        const double scaled = qBound(-fullScale(), value * fullScale(), fullScale() - 1);
+        QMixerRawSample<Bytes, Order>::store(p, quint32(qint32(std::llrint(scaled))));
+    }
+};
+
+template <int Bytes, QSysInfo::Endian Order>
+struct QMixerSampleCodec<QMixerUnsignedSample, Bytes, Order>
+{
+    enum { Size = Bytes };
+
+    static double fullScale() { return double(quint32(1) << (8 * Bytes - 1)); }
+
+    static float load(const uchar *p)
+    {
+        return float((double(QMixerRawSample<Bytes, Order>::load(p)) - fullScale()) / fullScale());
+    }
+
+    static void store(uchar *p, float value)
+    {
+        const double scaled = qBound(0.0, value * fullScale() + fullScale(), 2 * fullScale() - 1);
+        QMixerRawSample<Bytes, Order>::store(p, quint32(std::llrint(scaled)));
+    }
+};
+
+template <QSysInfo::Endian Order>
+struct QMixerSampleCodec<QMixerFloatSample, 4, Order>
+{
+    enum { Size = 4 };
+
+    static float load(const uchar *p)
+    {
+        const quint32 bits = QMixerRawSample<4, Order>::load(p);
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    static void store(uchar *p, float value)
+    {
+        value = qBound(-1.0f, value, 1.0f);
+        quint32 bits;
+        memcpy(&bits, &value, sizeof(bits));
+        QMixerRawSample<4, Order>::store(p, bits);
+    }
+};
+
+// The block operations the mixer needs for one output format, resolved once
+// by qMixerFormatKernels(). A table with a null accumulate entry means the
+// format isn't supported.
+struct QMixerFormatKernels
+{
+    int bytesPerSample;
+
+    // bus[i] += gain * sample i of src
+    void (*accumulate)(float *bus, const char *src, qint64 count, float gain);
+    // sample i of dst = saturate(bus[i])
+    void (*store)(char *dst, const float *bus, qint64 count);
+    // sample i of dst = saturate(sample i of dst + sample i of src)
+    void (*mix)(char *dst, const char *src, qint64 count);
+    // sample i of data = saturate(gain * sample i of data)
+    void (*scale)(char *data, qint64 count, float gain);
+    // the same with a gain per sample, for gain ramps and panning
+    void (*accumulateWeighted)(float *bus, const char *src, qint64 count, const float *gains);
+    void (*scaleWeighted)(char *data, qint64 count, const float *gains);
+    // the largest magnitude and the sum of the squares of count samples of src
+    void (*measure)(const char *src, qint64 count, float *peak, float *sumSquares);
+
+    bool isValid() const { return accumulate != nullptr; }
+};
+
+QMixerFormatKernels qMixerFormatKernels(const QAudioFormat &format);
+
+#endif // QMIXERFORMAT_P_H
@@ -0,0 +1,22 @@
+#ifndef QMIXERINSERT_H
+#define QMIXERINSERT_H
+
+#include <QtGlobal>
+
+#include "qtmixer.h"
+
+// An effect in the signal path of a submix bus, see QMixerStream::setBusInsert().
+// process() runs on the mixing thread, once per block, on the bus's float
+// buffer before its gain is applied; like the rest of the mix it must neither
+// block nor allocate.
+class QTMIXER_EXPORT QMixerInsert
+{
+public:
+    virtual ~QMixerInsert() {}
+
+    // samples holds frames interleaved frames of channels samples each,
+    // nominally in [-1, 1]; process them in place
+    virtual void process(float *samples, qint64 frames, int channels) = 0;
+};
+
+#endif // QMIXERINSERT_H
@@ -0,0 +1,548 @@
+#include <QDebug>
+
+#include <cmath>
+
+#include "qmixerkernels_p.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define QTMIXER_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define QTMIXER_TARGET(t) __attribute__((target(t)))
+#else
+#define QTMIXER_TARGET(t)
+#endif
+
+namespace {
+
+const float S16Scale = 32768.0f;
+const float S16Min = -32768.0f;
+const float S16Max = 32767.0f;
+
+inline qint16 saturateS16(qint32 value)
+{
+    return qint16(qBound<qint32>(-32768, value, 32767));
+}
+
+inline qint16 convertS16(float value)
+{
+    return qint16(std::lrint(qBound(S16Min, value * S16Scale, S16Max)));
+}
+
+// scalar
+
+void mixS16Scalar(qint16 *dst, const qint16 *src, qint64 count)
+{
+    for (qint64 i = 0; i < count; ++i) {
+        dst[i] = saturateS16(qint32(dst[i]) + src[i]);
+    }
+}
+
+void accumulateS16Scalar(float *dst, const qint16 *src, qint64 count, float gain)
+{
+    const float scale = gain / S16Scale;
+    for (qint64 i = 0; i < count; ++i) {
+        dst[i] += src[i] * scale;
+    }
+}
+
+void accumulateF32Scalar(float *dst, const float *src, qint64 count, float gain)
+{
+    for (qint64 i = 0; i < count; ++i) {
+        dst[i] += src[i] * gain;
+    }
+}
+
+void scaleS16Scalar(qint16 *data, qint64 count, float gain)
+{
+    for (qint64 i = 0; i < count; ++i) {
+        data[i] = qint16(std::lrint(qBound(S16Min, data[i] * gain, S16Max)));
+    }
+}
+
+void accumulateS16WeightedScalar(float *dst, const qint16 *src, qint64 count, const float *gains)
+{
+    for (qint64 i = 0; i < count; ++i) {
+        dst[i] += src[i] * gains[i] / S16Scale;
+    }
+}
+
+void accumulateF32WeightedScalar(float *dst, const float *src, qint64 count, const float *gains)
+{
+    for (qint64 i = 0; i < count; ++i) {
+        dst[i] += src[i] * gains[i];
+    }
+}
+
+void scaleS16WeightedScalar(qint16 *data, qint64 count, const float *gains)
+{
+    for (qint64 i = 0; i < count; ++i) {
+        data[i] = qint16(std::lrint(qBound(S16Min, data[i] * gains[i], S16Max)));
+    }
+}
+
+void convertF32ToS16Scalar(qint16 *dst, const float *src, qint64 count)
+{
+    for (qint64 i = 0; i < count; ++i) {
+        dst[i] = convertS16(src[i]);
+    }
+}
+
+void measureS16Scalar(const qint16 *src, qint64 count, float *peak, float *sumSquares)
+{
+    qint32 maximum = 0;
+    float sum = 0.0f;
+    for (qint64 i = 0; i < count; ++i) {
+        const qint32 value = src[i];
+        maximum = qMax(maximum, qAbs(value));
+        sum += float(value) * float(value);
+    }
+    *peak = maximum / S16Scale;
+    *sumSquares = sum / (S16Scale * S16Scale);
+}
+
+void measureF32Scalar(const float *src, qint64 count, float *peak, float *sumSquares)
+{
+    float maximum = 0.0f;
+    float sum = 0.0f;
+    for (qint64 i = 0; i < count; ++i) {
+        maximum = qMax(maximum, std::fabs(src[i]));
+        sum += src[i] * src[i];
+    }
+    *peak = maximum;
+    *sumSquares = sum;
+}
+
+#ifdef QTMIXER_X86
+
+// SSE2
+
+QTMIXER_TARGET("sse2")
+void mixS16Sse2(qint16 *dst, const qint16 *src, qint64 count)
+{
+    qint64 i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_adds_epi16(a, b));
+    }
+    mixS16Scalar(dst + i, src + i, count - i);
+}
+
+QTMIXER_TARGET("sse2")
+void accumulateS16Sse2(float *dst, const qint16 *src, qint64 count, float gain)
+{
+    const __m128 scale = _mm_set1_ps(gain / S16Scale);
+    qint64 i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        // sign-extend by placing each sample in the high half of a 32 bit lane
+        const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+        const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16);
+        const __m128 flo = _mm_mul_ps(_mm_cvtepi32_ps(lo), scale);
+        const __m128 fhi = _mm_mul_ps(_mm_cvtepi32_ps(hi), scale);
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), flo));
+        _mm_storeu_ps(dst + i + 4, _mm_add_ps(_mm_loadu_ps(dst + i + 4), fhi));
+    }
+    accumulateS16Scalar(dst + i, src + i, count - i, gain);
+}
+
+QTMIXER_TARGET("sse2")
+void accumulateF32Sse2(float *dst, const float *src, qint64 count, float gain)
+{
+    const __m128 g = _mm_set1_ps(gain);
+    qint64 i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128 f = _mm_mul_ps(_mm_loadu_ps(src + i), g);
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), f));
+    }
+    accumulateF32Scalar(dst + i, src + i, count - i, gain);
+}
+
+QTMIXER_TARGET("sse2")
+void scaleS16Sse2(qint16 *data, qint64 count, float gain)
+{
+    const __m128 g = _mm_set1_ps(gain);
+    const __m128 lower = _mm_set1_ps(S16Min);
+    const __m128 upper = _mm_set1_ps(S16Max);
+    qint64 i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        const __m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16));
+        const __m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16));
+        const __m128 a = _mm_min_ps(_mm_max_ps(_mm_mul_ps(lo, g), lower), upper);
+        const __m128 b = _mm_min_ps(_mm_max_ps(_mm_mul_ps(hi, g), lower), upper);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(data + i), _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b)));
+    }
+    scaleS16Scalar(data + i, count - i, gain);
+}
+
+QTMIXER_TARGET("sse2")
+void accumulateS16WeightedSse2(float *dst, const qint16 *src, qint64 count, const float *gains)
+{
+    const __m128 scale = _mm_set1_ps(1.0f / S16Scale);
+    qint64 i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        const __m128 glo = _mm_mul_ps(_mm_loadu_ps(gains + i), scale);
+        const __m128 ghi = _mm_mul_ps(_mm_loadu_ps(gains + i + 4), scale);
+        const __m128 flo = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16)), glo);
+        const __m128 fhi = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16)), ghi);
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), flo));
+        _mm_storeu_ps(dst + i + 4, _mm_add_ps(_mm_loadu_ps(dst + i + 4), fhi));
+    }
+    accumulateS16WeightedScalar(dst + i, src + i, count - i, gains + i);
+}
+
+QTMIXER_TARGET("sse2")
+void accumulateF32WeightedSse2(float *dst, const float *src, qint64 count, const float *gains)
+{
+    qint64 i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128 f = _mm_mul_ps(_mm_loadu_ps(src + i), _mm_loadu_ps(gains + i));
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), f));
+    }
+    accumulateF32WeightedScalar(dst + i, src + i, count - i, gains + i);
+}
+
+QTMIXER_TARGET("sse2")
+void scaleS16WeightedSse2(qint16 *data, qint64 count, const float *gains)
+{
+    const __m128 lower = _mm_set1_ps(S16Min);
+    const __m128 upper = _mm_set1_ps(S16Max);
+    qint64 i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        const __m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16));
+        const __m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16));
+        const __m128 a = _mm_min_ps(_mm_max_ps(_mm_mul_ps(lo, _mm_loadu_ps(gains + i)), lower), upper);
+        const __m128 b = _mm_min_ps(_mm_max_ps(_mm_mul_ps(hi, _mm_loadu_ps(gains + i + 4)), lower), upper);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(data + i), _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b)));
+    }
+    scaleS16WeightedScalar(data + i, count - i, gains + i);
+}
+
+QTMIXER_TARGET("sse2")
+void convertF32ToS16Sse2(qint16 *dst, const float *src, qint64 count)
+{
+    const __m128 scale = _mm_set1_ps(S16Scale);
+    const __m128 lower = _mm_set1_ps(S16Min);
+    const __m128 upper = _mm_set1_ps(S16Max);
+    qint64 i = 0;
+    for (; i + 8 <= count; i += 8) {
+        // clamp before converting: out of range floats convert to INT_MIN
+        const __m128 a = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i), scale), lower), upper);
+        const __m128 b = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i + 4), scale), lower), upper);
+        const __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), packed);
+    }
+    convertF32ToS16Scalar(dst + i, src + i, count - i);
+}
+
+// folds the lanes of the running maxima and sums into the scalar results of the tail
+QTMIXER_TARGET("sse2")
+void reduceSse2(__m128 maxima, __m128 sums, float scale, float *peak, float *sumSquares)
+{
+    float m[4];
+    float s[4];
+    _mm_storeu_ps(m, maxima);
+    _mm_storeu_ps(s, sums);
+    *peak = qMax(*peak, qMax(qMax(m[0], m[1]), qMax(m[2], m[3])) * scale);
+    *sumSquares += (s[0] + s[1] + s[2] + s[3]) * scale * scale;
+}
+
+QTMIXER_TARGET("sse2")
+void measureS16Sse2(const qint16 *src, qint64 count, float *peak, float *sumSquares)
+{
+    const __m128 magnitude = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128 maxima = _mm_setzero_ps();
+    __m128 sums = _mm_setzero_ps();
+    qint64 i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        const __m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16));
+        const __m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16));
+        maxima = _mm_max_ps(maxima, _mm_max_ps(_mm_and_ps(lo, magnitude), _mm_and_ps(hi, magnitude)));
+        sums = _mm_add_ps(sums, _mm_add_ps(_mm_mul_ps(lo, lo), _mm_mul_ps(hi, hi)));
+    }
+    measureS16Scalar(src + i, count - i, peak, sumSquares);
+    reduceSse2(maxima, sums, 1.0f / S16Scale, peak, sumSquares);
+}
+
+QTMIXER_TARGET("sse2")
+void measureF32Sse2(const float *src, qint64 count, float *peak, float *sumSquares)
+{
+    const __m128 magnitude = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128 maxima = _mm_setzero_ps();
+    __m128 sums = _mm_setzero_ps();
+    qint64 i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128 f = _mm_loadu_ps(src + i);
+        maxima = _mm_max_ps(maxima, _mm_and_ps(f, magnitude));
+        sums = _mm_add_ps(sums, _mm_mul_ps(f, f));
+    }
+    measureF32Scalar(src + i, count - i, peak, sumSquares);
+    reduceSse2(maxima, sums, 1.0f, peak, sumSquares);
+}
+
+// AVX2
+
+QTMIXER_TARGET("avx2")
+void mixS16Avx2(qint16 *dst, const qint16 *src, qint64 count)
+{
+    qint64 i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dst + i));
+        const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_adds_epi16(a, b));
+    }
+    mixS16Scalar(dst + i, src + i, count - i);
+}
+
+QTMIXER_TARGET("avx2")
+void accumulateS16Avx2(float *dst, const qint16 *src, qint64 count, float gain)
+{
+    const __m256 scale = _mm256_set1_ps(gain / S16Scale);
+    qint64 i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        const __m256 f = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(s)), scale);
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), f));
+    }
+    accumulateS16Scalar(dst + i, src + i, count - i, gain);
+}
+
+QTMIXER_TARGET("avx2")
+void accumulateF32Avx2(float *dst, const float *src, qint64 count, float gain)
+{
+    const __m256 g = _mm256_set1_ps(gain);
+    qint64 i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256 f = _mm256_mul_ps(_mm256_loadu_ps(src + i), g);
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), f));
+    }
+    accumulateF32Scalar(dst + i, src + i, count - i, gain);
+}
+
+QTMIXER_TARGET("avx2")
+void scaleS16Avx2(qint16 *data, qint64 count, float gain)
+{
+    const __m256 g = _mm256_set1_ps(gain);
+    const __m256 lower = _mm256_set1_ps(S16Min);
+    const __m256 upper = _mm256_set1_ps(S16Max);
+    qint64 i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m256 lo = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i))));
+        const __m256 hi = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i + 8))));
+        const __m256 a = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(lo, g), lower), upper);
+        const __m256 b = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(hi, g), lower), upper);
+        const __m256i packed = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(data + i), _mm256_permute4x64_epi64(packed, 0xD8));
+    }
+    scaleS16Scalar(data + i, count - i, gain);
+}
+
+QTMIXER_TARGET("avx2")
+void accumulateS16WeightedAvx2(float *dst, const qint16 *src, qint64 count, const float *gains)
+{
+    const __m256 scale = _mm256_set1_ps(1.0f / S16Scale);
+    qint64 i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        const __m256 g = _mm256_mul_ps(_mm256_loadu_ps(gains + i), scale);
+        const __m256 f = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(s)), g);
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), f));
+    }
+    accumulateS16WeightedScalar(dst + i, src + i, count - i, gains + i);
+}
+
+QTMIXER_TARGET("avx2")
+void accumulateF32WeightedAvx2(float *dst, const float *src, qint64 count, const float *gains)
+{
+    qint64 i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256 f = _mm256_mul_ps(_mm256_loadu_ps(src + i), _mm256_loadu_ps(gains + i));
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), f));
+    }
+    accumulateF32WeightedScalar(dst + i, src + i, count - i, gains + i);
+}
+
+QTMIXER_TARGET("avx2")
+void scaleS16WeightedAvx2(qint16 *data, qint64 count, const float *gains)
+{
+    const __m256 lower = _mm256_set1_ps(S16Min);
+    const __m256 upper = _mm256_set1_ps(S16Max);
+    qint64 i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m256 lo = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i))));
+        const __m256 hi = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i + 8))));
+        const __m256 a = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(lo, _mm256_loadu_ps(gains + i)), lower), upper);
+        const __m256 b = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(hi, _mm256_loadu_ps(gains + i + 8)), lower), upper);
+        const __m256i packed = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(data + i), _mm256_permute4x64_epi64(packed, 0xD8));
+    }
+    scaleS16WeightedScalar(data + i, count - i, gains + i);
+}
+
+QTMIXER_TARGET("avx2")
+void convertF32ToS16Avx2(qint16 *dst, const float *src, qint64 count)
+{
+    const __m256 scale = _mm256_set1_ps(S16Scale);
+    const __m256 lower = _mm256_set1_ps(S16Min);
+    const __m256 upper = _mm256_set1_ps(S16Max);
+    qint64 i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m256 a = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i), scale), lower), upper);
+        const __m256 b = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i + 8), scale), lower), upper);
+        // packs works per 128 bit lane, so restore the sample order afterwards
+        const __m256i packed = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_permute4x64_epi64(packed, 0xD8));
+    }
+    convertF32ToS16Scalar(dst + i, src + i, count - i);
+}
+
+QTMIXER_TARGET("avx2")
+void measureS16Avx2(const qint16 *src, qint64 count, float *peak, float *sumSquares)
+{
+    const __m256 magnitude = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    __m256 maxima = _mm256_setzero_ps();
+    __m256 sums = _mm256_setzero_ps();
+    qint64 i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        const __m256 f = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(s));
+        maxima = _mm256_max_ps(maxima, _mm256_and_ps(f, magnitude));
+        sums = _mm256_add_ps(sums, _mm256_mul_ps(f, f));
+    }
+    measureS16Scalar(src + i, count - i, peak, sumSquares);
+    reduceSse2(_mm_max_ps(_mm256_castps256_ps128(maxima), _mm256_extractf128_ps(maxima, 1)),
+               _mm_add_ps(_mm256_castps256_ps128(sums), _mm256_extractf128_ps(sums, 1)),
+               1.0f / S16Scale, peak, sumSquares);
+}
+
+QTMIXER_TARGET("avx2")
+void measureF32Avx2(const float *src, qint64 count, float *peak, float *sumSquares)
+{
+    const __m256 magnitude = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    __m256 maxima = _mm256_setzero_ps();
+    __m256 sums = _mm256_setzero_ps();
+    qint64 i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256 f = _mm256_loadu_ps(src + i);
+        maxima = _mm256_max_ps(maxima, _mm256_and_ps(f, magnitude));
+        sums = _mm256_add_ps(sums, _mm256_mul_ps(f, f));
+    }
+    measureF32Scalar(src + i, count - i, peak, sumSquares);
+    reduceSse2(_mm_max_ps(_mm256_castps256_ps128(maxima), _mm256_extractf128_ps(maxima, 1)),
+               _mm_add_ps(_mm256_castps256_ps128(sums), _mm256_extractf128_ps(sums, 1)),
+               1.0f, peak, sumSquares);
+}
+
+bool cpuHasSse2()
+{
+#if defined(__x86_64__) || defined(_M_X64)
+    return true;
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return info[3] & (1 << 26);
+#else
+    return __builtin_cpu_supports("sse2");
+#endif
+}
+
+bool cpuHasAvx2()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    __cpuid(info, 1);
+    // the OS must also save the YMM registers on context switches
+    const bool osxsave = info[2] & (1 << 27);
+    if (!osxsave || (_xgetbv(0) & 0x6) != 0x6) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return info[1] & (1 << 5);
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // QTMIXER_X86
+
+QMixerKernels selectKernels()
+{
+    const QByteArray cap = qgetenv("QTMIXER_SIMD").toLower();
+
+    QMixerKernels kernels = {
+        "scalar",
+        mixS16Scalar,
+        accumulateS16Scalar,
+        accumulateF32Scalar,
+        scaleS16Scalar,
+        accumulateS16WeightedScalar,
+        accumulateF32WeightedScalar,
+        scaleS16WeightedScalar,
+        convertF32ToS16Scalar,
+        measureS16Scalar,
+        measureF32Scalar
+    };
+
+#ifdef QTMIXER_X86
+    if (cap == "scalar") {
+        return kernels;
+    }
+    if (cpuHasSse2()) {
+        kernels = {
+            "sse2",
+            mixS16Sse2,
+            accumulateS16Sse2,
+            accumulateF32Sse2,
+            scaleS16Sse2,
+            accumulateS16WeightedSse2,
+            accumulateF32WeightedSse2,
+            scaleS16WeightedSse2,
+            convertF32ToS16Sse2,
+            measureS16Sse2,
+            measureF32Sse2
+        };
+    }
+    if (cap != "sse2" && cpuHasAvx2()) {
+        kernels = {
+            "avx2",
+            mixS16Avx2,
+            accumulateS16Avx2,
+            accumulateF32Avx2,
+            scaleS16Avx2,
+            accumulateS16WeightedAvx2,
+            accumulateF32WeightedAvx2,
+            scaleS16WeightedAvx2,
+            convertF32ToS16Avx2,
+            measureS16Avx2,
+            measureF32Avx2
+        };
+    }
+#else
+    Q_UNUSED(cap);
+#endif
+
+    return kernels;
+}
+
+} // namespace
+
+const QMixerKernels &qMixerKernels()
+{
+    // thread-safe one-time initialisation
+    static const QMixerKernels kernels = selectKernels();
+    return kernels;
+}
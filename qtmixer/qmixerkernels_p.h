@@ -0,0 +1,37 @@
+#ifndef QMIXERKERNELS_P_H
+#define QMIXERKERNELS_P_H
+
+#include <QtGlobal>
+
+// The inner loops of the mixer. Every entry exists in a scalar version and,
+// on x86, in SSE2 and AVX2 versions; the best set supported by the CPU we run
+// on is selected once, the first time qMixerKernels() is called.
+// Setting QTMIXER_SIMD to "scalar", "sse2" or "avx2" caps the selection,
+// which is useful to compare the implementations.
+struct QMixerKernels
+{
+    const char *name;
+
+    // dst[i] = saturate(dst[i] + src[i])
+    void (*mixS16)(qint16 *dst, const qint16 *src, qint64 count);
+    // dst[i] += src[i] * gain / 32768
+    void (*accumulateS16)(float *dst, const qint16 *src, qint64 count, float gain);
+    // dst[i] += src[i] * gain
+    void (*accumulateF32)(float *dst, const float *src, qint64 count, float gain);
+    // data[i] = saturate(data[i] * gain)
+    void (*scaleS16)(qint16 *data, qint64 count, float gain);
+    // the same with a gain per sample, for gain ramps and panning
+    void (*accumulateS16Weighted)(float *dst, const qint16 *src, qint64 count, const float *gains);
+    void (*accumulateF32Weighted)(float *dst, const float *src, qint64 count, const float *gains);
+    void (*scaleS16Weighted)(qint16 *data, qint64 count, const float *gains);
+    // dst[i] = saturate(src[i] * 32768)
+    void (*convertF32ToS16)(qint16 *dst, const float *src, qint64 count);
+    // the largest magnitude and the sum of the squares of the samples,
+    // relative to full scale; for the level meters
+    void (*measureS16)(const qint16 *src, qint64 count, float *peak, float *sumSquares);
+    void (*measureF32)(const float *src, qint64 count, float *peak, float *sumSquares);
+};
+
+const QMixerKernels &qMixerKernels();
+
+#endif // QMIXERKERNELS_P_H
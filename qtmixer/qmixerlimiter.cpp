@@ -0,0 +1,147 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "qmixerlimiter_p.h"
+
+namespace {
+
+// the level the output is held below, -0.3 dBFS
+const float Ceiling = 0.966f;
+// what the envelope aims for, a hair below the ceiling, so that rounding
+// in averaging the gain and applying it can't take a peak over it
+const float Target = Ceiling * (1.0f - 1e-5f);
+
+}
+
+QMixerLimiter::QMixerLimiter()
+    : m_channels(0)
+    , m_lookahead(0)
+    , m_releaseCoefficient(1.0f)
+    , m_windowHead(0)
+    , m_windowCount(0)
+    , m_frame(0)
+    , m_tail(0)
+    , m_release(1.0f)
+    , m_boxPos(0)
+    , m_boxSum(0)
+{
+}
+
+void QMixerLimiter::configure(int channels, int lookahead, int release)
+{
+    m_channels = qMax(channels, 1);
+    m_lookahead = qMax(lookahead, 1);
+    m_releaseCoefficient = float(1.0 - std::exp(-1.0 / qMax(release, 1)));
+
+    m_line.fill(0.0f, (m_lookahead + MaxBlockFrames) * m_channels);
+    m_peaks.resize(MaxBlockFrames);
+    m_gains.resize(MaxBlockFrames);
+    m_windowGains.resize(m_lookahead + 1);
+    m_windowFrames.resize(m_lookahead + 1);
+    m_box.resize(m_lookahead);
+    reset();
+}
+
+void QMixerLimiter::reset()
+{
+    if (!m_channels) {
+        return;
+    }
+    memset(m_line.data(), 0, m_lookahead * m_channels * sizeof(float));
+    m_windowHead = 0;
+    m_windowCount = 0;
+    m_frame = 0;
+    m_tail = 0;
+    m_release = 1.0f;
+    std::fill(m_box.begin(), m_box.end(), 1.0f);
+    m_boxPos = 0;
+    m_boxSum = m_lookahead;
+}
+
+void QMixerLimiter::process(float *samples, qint64 frames)
+{
+    if (!m_channels) {
+        return;
+    }
+    while (frames > 0) {
+        const int block = int(qMin<qint64>(frames, MaxBlockFrames));
+        processBlock(samples, block);
+        samples += block * m_channels;
+        frames -= block;
+    }
+}
+
+void QMixerLimiter::processBlock(float *samples, int frames)
+{
+    const int channels = m_channels;
+    const int lookahead = m_lookahead;
+    const int window = lookahead + 1;
+    float *peaks = m_peaks.data();
+    float *gains = m_gains.data();
+    float *line = m_line.data();
+
+    // the peak of every frame; a plain loop the compiler vectorises
+    int lastSound = -1;
+    for (int f = 0; f < frames; ++f) {
+        float peak = 0.0f;
+        for (int c = 0; c < channels; ++c) {
+            peak = qMax(peak, std::fabs(samples[f * channels + c]));
+        }
+        peaks[f] = peak;
+        lastSound = peak > 0.0f ? f : lastSound;
+    }
+    // the input that goes into the delay line rather than out
+    m_tail = lastSound >= 0 ? lookahead - (frames - 1 - lastSound) : m_tail - frames;
+
+    // the gain envelope, inherently serial but O(1) per frame
+    for (int f = 0; f < frames; ++f, ++m_frame) {
+        const float target = peaks[f] > Target ? Target / peaks[f] : 1.0f;
+
+        // drop the entry that left the window first, so that the ring never
+        // holds more than the lookahead + 1 frames it has room for, then
+        // those that can never be the minimum again
+        if (m_windowCount && m_windowFrames.at(m_windowHead) < m_frame - lookahead) {
+            m_windowHead = (m_windowHead + 1) % window;
+            --m_windowCount;
+        }
+        while (m_windowCount
+               && m_windowGains.at((m_windowHead + m_windowCount - 1) % window) >= target) {
+            --m_windowCount;
+        }
+        const int tail = (m_windowHead + m_windowCount) % window;
+        m_windowGains[tail] = target;
+        m_windowFrames[tail] = m_frame;
+        ++m_windowCount;
+        const float held = m_windowGains.at(m_windowHead);
+
+        m_release = held < m_release ? held
+                    : m_release + (held - m_release) * m_releaseCoefficient;
+
+        m_boxSum += m_release - m_box.at(m_boxPos);
+        m_box[m_boxPos] = m_release;
+        m_boxPos = (m_boxPos + 1) % lookahead;
+        if (!m_boxPos) {
+            // sum afresh once per lap, so that rounding can't build up in
+            // the running sum and lift the average above the held gain
+            m_boxSum = 0;
+            for (float gain : m_box) {
+                m_boxSum += gain;
+            }
+        }
+        gains[f] = float(m_boxSum / lookahead);
+    }
+
+    // delay the block behind the lookahead and apply the envelope; the
+    // envelope holds the output below the ceiling, the bound is only there
+    // to keep a slip in it from reaching the output
+    const int count = frames * channels;
+    memcpy(line + lookahead * channels, samples, count * sizeof(float));
+    for (int f = 0; f < frames; ++f) {
+        const float gain = gains[f];
+        for (int c = 0; c < channels; ++c) {
+            samples[f * channels + c] = qBound(-Ceiling, line[f * channels + c] * gain, Ceiling);
+        }
+    }
+    memmove(line, line + count, lookahead * channels * sizeof(float));
+}
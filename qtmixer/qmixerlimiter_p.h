@@ -0,0 +1,66 @@
+#ifndef QMIXERLIMITER_P_H
+#define QMIXERLIMITER_P_H
+
+#include <QVector>
+
+// Look-ahead peak limiter for the master bus. The output is delayed by the
+// lookahead, so that the gain can be brought down smoothly before a peak
+// comes out instead of clipping it:
+//  - the gain each frame needs to stay below the ceiling is held for the
+//    lookahead with a sliding window minimum (a monotonic queue, O(1) per frame),
+//  - recovers from there with an exponential release,
+//  - and is averaged over the lookahead, which makes it ramp down linearly
+//    ahead of a peak while still reaching the held value in time.
+// configure() allocates, process() never does: it works through longer
+// calls MaxBlockFrames at a time.
+class QMixerLimiter
+{
+public:
+    enum {
+        MaxBlockFrames = 1024
+    };
+
+    QMixerLimiter();
+
+    // lookahead and release in frames
+    void configure(int channels, int lookahead, int release);
+    // forget the delayed audio and the envelope, without allocating
+    void reset();
+
+    // limits frames interleaved frames in place
+    void process(float *samples, qint64 frames);
+
+    // whether the delay line still holds some of the input, which takes
+    // feeding it silence to come out
+    bool hasTail() const { return m_tail > 0; }
+
+private:
+    void processBlock(float *samples, int frames);
+
+    int m_channels;
+    int m_lookahead;
+    float m_releaseCoefficient;
+
+    // the delayed input, m_lookahead frames followed by room for a block
+    QVector<float> m_line;
+    // per frame scratch for a block of up to MaxBlockFrames
+    QVector<float> m_peaks;
+    QVector<float> m_gains;
+
+    // the sliding window minimum, a ring of m_lookahead + 1 (gain, frame) pairs
+    QVector<float> m_windowGains;
+    QVector<qint64> m_windowFrames;
+    int m_windowHead;
+    int m_windowCount;
+    qint64 m_frame;
+    // the frames of the delay line that may not be silent
+    qint64 m_tail;
+
+    float m_release;
+    // the running average over the last m_lookahead released gains
+    QVector<float> m_box;
+    int m_boxPos;
+    double m_boxSum;
+};
+
+#endif // QMIXERLIMITER_P_H
@@ -0,0 +1,45 @@
+#include <QByteArray>
+
+#include "qmixerrenderthread_p.h"
+#include "qmixerstream_p.h"
+
+QMixerRenderThread::QMixerRenderThread(QMixerStreamPrivate *mixer)
+    : m_mixer(mixer)
+{
+    setObjectName(QStringLiteral("QMixerRenderThread"));
+}
+
+void QMixerRenderThread::stop()
+{
+    requestInterruption();
+    wait();
+}
+
+void QMixerRenderThread::run()
+{
+    QMixerStreamPrivate *d = m_mixer;
+    const int frameBytes = qMax(1, d->m_format.bytesPerFrame());
+    const int target = qMin(d->m_ring.capacity(),
+                            d->m_format.bytesForDuration(qint64(d->m_renderBufferDuration) * 1000));
+
+    // render in whole frames, a quarter of the buffer depth at a time
+    const int block = qMax(frameBytes, target / 4 / frameBytes * frameBytes);
+    QByteArray buffer(block, Qt::Uninitialized);
+
+    // wake up twice per block so the ring never drains by more than a block
+    const unsigned long interval = qMax<qint64>(1000, d->m_format.durationForBytes(block) / 2);
+
+    while (!isInterruptionRequested()) {
+        while (d->m_ring.available() + block <= target) {
+            const qint64 n = d->mix(buffer.data(), block);
+            if (n <= 0) {
+                break;
+            }
+            d->m_ring.write(buffer.constData(), int(n));
+            if (n < block) {
+                break;
+            }
+        }
+        QThread::usleep(interval);
+    }
+}
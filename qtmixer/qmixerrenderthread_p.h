@@ -0,0 +1,24 @@
+#ifndef QMIXERRENDERTHREAD_P_H
+#define QMIXERRENDERTHREAD_P_H
+
+#include <QThread>
+
+class QMixerStreamPrivate;
+
+// Runs the mix ahead of time into QMixerStreamPrivate::m_ring, keeping it
+// filled up to the configured render buffer depth.
+class QMixerRenderThread : public QThread
+{
+public:
+    explicit QMixerRenderThread(QMixerStreamPrivate *mixer);
+
+    void stop();
+
+protected:
+    void run() override;
+
+private:
+    QMixerStreamPrivate *m_mixer;
+};
+
+#endif // QMIXERRENDERTHREAD_P_H
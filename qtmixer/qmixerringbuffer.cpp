@@ -0,0 +1,80 @@
+#include <cstring>
+
+#include "qmixerringbuffer_p.h"
+
+QMixerRingBuffer::QMixerRingBuffer(int capacity)
+    : m_mask(0)
+    , m_readPos(0)
+    , m_writePos(0)
+{
+    resize(capacity);
+}
+
+void QMixerRingBuffer::resize(int capacity)
+{
+    int size = capacity > 0 ? 1 : 0;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    m_buffer.resize(size);
+    m_mask = size ? quint32(size - 1) : 0;
+    clear();
+}
+
+void QMixerRingBuffer::clear()
+{
+    m_readPos.store(0);
+    m_writePos.store(0);
+}
+
+int QMixerRingBuffer::available() const
+{
+    return int(m_writePos.loadAcquire() - m_readPos.loadAcquire());
+}
+
+int QMixerRingBuffer::write(const char *data, int len)
+{
+    const quint32 writePos = m_writePos.load();
+    len = qMin(len, capacity() - int(writePos - m_readPos.loadAcquire()));
+    if (len <= 0) {
+        return 0;
+    }
+
+    const int offset = int(writePos & m_mask);
+    const int first = qMin(len, capacity() - offset);
+    memcpy(m_buffer.data() + offset, data, first);
+    memcpy(m_buffer.data(), data + first, len - first);
+
+    // publish the data only once it has been copied
+    m_writePos.storeRelease(writePos + len);
+    return len;
+}
+
+int QMixerRingBuffer::read(char *data, int len)
+{
+    const quint32 readPos = m_readPos.load();
+    len = qMin(len, int(m_writePos.loadAcquire() - readPos));
+    if (len <= 0) {
+        return 0;
+    }
+
+    const int offset = int(readPos & m_mask);
+    const int first = qMin(len, capacity() - offset);
+    memcpy(data, m_buffer.constData() + offset, first);
+    memcpy(data + first, m_buffer.constData(), len - first);
+
+    m_readPos.storeRelease(readPos + len);
+    return len;
+}
+
+int QMixerRingBuffer::skip(int len)
+{
+    const quint32 readPos = m_readPos.load();
+    len = qMin(len, int(m_writePos.loadAcquire() - readPos));
+    if (len <= 0) {
+        return 0;
+    }
+
+    m_readPos.storeRelease(readPos + len);
+    return len;
+}
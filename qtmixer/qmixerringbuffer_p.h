@@ -0,0 +1,38 @@
+#ifndef QMIXERRINGBUFFER_P_H
+#define QMIXERRINGBUFFER_P_H
+
+#include <QAtomicInteger>
+#include <QByteArray>
+
+// Lock-free single producer, single consumer byte ring. One thread may call
+// write(), another read()/skip(); neither ever blocks. The read and write
+// counters run freely and wrap around, the capacity is a power of two.
+// resize() and clear() must only be called while neither side is active.
+class QMixerRingBuffer
+{
+public:
+    explicit QMixerRingBuffer(int capacity = 0);
+
+    void resize(int capacity);
+    void clear();
+
+    int capacity() const { return m_buffer.size(); }
+    // bytes that can be read right now
+    int available() const;
+    // bytes that can be written right now
+    int free() const { return capacity() - available(); }
+
+    // producer side
+    int write(const char *data, int len);
+    // consumer side
+    int read(char *data, int len);
+    int skip(int len);
+
+private:
+    QByteArray m_buffer;
+    quint32 m_mask;
+    QAtomicInteger<quint32> m_readPos;
+    QAtomicInteger<quint32> m_writePos;
+};
+
+#endif // QMIXERRINGBUFFER_P_H
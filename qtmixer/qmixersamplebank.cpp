@@ -0,0 +1,187 @@
+#include <cstring>
+
+#include <QDebug>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <QWeakPointer>
+
+#include "qmixersamplebank_p.h"
+#include "qmixerdiskcache_p.h"
+#include "qmixerdecodepool_p.h"
+
+QMixerSample::QMixerSample(const QString &fileName, const QAudioFormat &format)
+    : m_fileName(fileName)
+    , m_file(fileName, this)
+    , m_decoder(this)
+    , m_format(format)
+    , m_cacheFile(this)
+    , m_mapped(nullptr)
+    , m_mappedSize(0)
+    , m_complete(0)
+    , m_valid(false)
+    , m_decodeError(QAudioDecoder::NoError)
+{
+    m_mapped = QMixerDiskCache::map(fileName, format, m_cacheFile, &m_mappedSize);
+    if (m_mapped) {
+        m_complete = 1;
+        m_valid = true;
+        return;
+    }
+
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        qCritical() << "File or buffer initialisation failure in QMixerSample";
+        return;
+    }
+    m_valid = true;
+
+    // decode on a pool thread; the file and the decoder are our children
+    // and move along
+    moveToThread(QMixerDecodePool::thread());
+    QMetaObject::invokeMethod(this, "start", Qt::QueuedConnection);
+}
+
+void QMixerSample::start()
+{
+    m_decoder.setNotifyInterval(10);
+    m_decoder.setAudioFormat(m_format);
+    m_decoder.setSourceDevice(&m_file);
+    m_decoder.start();
+
+    if (!m_decoder.error()) {
+        connect(&m_decoder, &QAudioDecoder::bufferReady, this, &QMixerSample::bufferReady);
+        connect(&m_decoder, static_cast<void(QAudioDecoder::*)(QAudioDecoder::Error)>(&QAudioDecoder::error),
+                this, &QMixerSample::decoderError);
+        connect(&m_decoder, &QAudioDecoder::finished, this, &QMixerSample::decoderFinished);
+    } else {
+        qCritical() << "Decoder error" << m_decoder.errorString() << "in QMixerSample";
+        m_decoder.stop();
+        fail(m_decoder.error(), m_decoder.errorString());
+    }
+}
+
+qint64 QMixerSample::size() const
+{
+    return m_mapped ? m_mappedSize : m_data.size();
+}
+
+qint64 QMixerSample::read(qint64 pos, char *data, qint64 maxlen) const
+{
+    if (!m_mapped) {
+        return m_data.read(pos, data, maxlen);
+    }
+    if (pos < 0 || pos >= m_mappedSize) {
+        return 0;
+    }
+    maxlen = qMin(maxlen, m_mappedSize - pos);
+    memcpy(data, m_mapped + pos, maxlen);
+    return maxlen;
+}
+
+void QMixerSample::bufferReady()
+{
+    const QAudioBuffer &buffer = m_decoder.read();
+
+    // goes into fresh chunks, what the voices are reading never moves
+    m_data.append(buffer.constData<char>(), buffer.byteCount());
+    emit dataAdded();
+}
+
+void QMixerSample::decoderError(QAudioDecoder::Error error)
+{
+    qDebug() << Q_FUNC_INFO << m_decoder.errorString();
+    fail(error, m_decoder.errorString());
+}
+
+// There won't be any more audio: the voices playing us end where decoding
+// stopped. We leave the bank, so that the next open decodes the file again
+// rather than joining a failed sample.
+void QMixerSample::fail(QAudioDecoder::Error error, const QString &errorString)
+{
+    m_decodeError = error;
+    m_errorString = errorString;
+    m_complete.storeRelease(1);
+    QMixerSampleBank::forget(m_fileName, m_format, this);
+    emit this->error(error, errorString);
+}
+
+void QMixerSample::decoderFinished()
+{
+    m_complete.storeRelease(1);
+    qWarning() << "Decoding done;" << m_data.size() << "bytes in"
+        << m_data.chunkCount() << "chunks, format:" << m_decoder.audioFormat();
+    // spare the next run the decoding
+    QMixerDiskCache::store(m_fileName, m_format, m_data);
+    emit finished();
+}
+
+QString qMixerSampleKey(const QString &fileName, const QAudioFormat &format)
+{
+    QFileInfo finfo(fileName);
+    const QString path = finfo.canonicalFilePath();
+    return QStringLiteral("%1|%2|%3|%4|%5|%6|%7")
+        .arg(path.isEmpty() ? finfo.absoluteFilePath() : path)
+        .arg(format.codec())
+        .arg(format.sampleRate())
+        .arg(format.channelCount())
+        .arg(format.sampleSize())
+        .arg(int(format.sampleType()))
+        .arg(int(format.byteOrder()));
+}
+
+namespace {
+
+struct SampleBank
+{
+    QMutex lock;
+    QHash<QString, QWeakPointer<QMixerSample> > samples;
+};
+
+Q_GLOBAL_STATIC(SampleBank, sampleBank)
+
+} // namespace
+
+QSharedPointer<QMixerSample> QMixerSampleBank::sample(const QString &fileName, const QAudioFormat &format)
+{
+    const QString key = qMixerSampleKey(fileName, format);
+    SampleBank *bank = sampleBank();
+
+    QMutexLocker lock(&bank->lock);
+    QSharedPointer<QMixerSample> sample = bank->samples.value(key).toStrongRef();
+    if (!sample) {
+        // the sample lives on a decode thread and may be released from any
+        // other; let its own thread delete it
+        sample = QSharedPointer<QMixerSample>(new QMixerSample(fileName, format), &QObject::deleteLater);
+        if (!sample->isValid()) {
+            // don't cache the failure, the file may be fine next time
+            return sample;
+        }
+        // forget the samples nobody uses any more
+        for (auto it = bank->samples.begin(); it != bank->samples.end();) {
+            if (it.value().isNull()) {
+                it = bank->samples.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        bank->samples.insert(key, sample);
+    }
+
+    return sample;
+}
+
+void QMixerSampleBank::forget(const QString &fileName, const QAudioFormat &format, const QMixerSample *sample)
+{
+    const QString key = qMixerSampleKey(fileName, format);
+    SampleBank *bank = sampleBank();
+
+    QMutexLocker lock(&bank->lock);
+    // another sample may have taken the key over already
+    if (bank->samples.value(key).toStrongRef().data() == sample) {
+        bank->samples.remove(key);
+    }
+}
+
+#include "moc_qmixersamplebank_p.cpp"
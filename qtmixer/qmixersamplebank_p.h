@@ -0,0 +1,82 @@
+#ifndef QMIXERSAMPLEBANK_P_H
+#define QMIXERSAMPLEBANK_P_H
+
+#include <QObject>
+#include <QFile>
+#include <QAudioDecoder>
+#include <QAudioFormat>
+#include <QAtomicInt>
+#include <QSharedPointer>
+
+#include "qmixersamplebuffer_p.h"
+
+// A file decoded into memory in a given format. Once decoded the data never
+// changes, so any number of voices can play it at the same time, each with
+// its own cursor. The decoder runs on a QMixerDecodePool thread, and so do
+// the signals.
+// When the disk cache has an entry for the file, the sample is mapped from
+// it instead and complete from the start.
+class QMixerSample : public QObject
+{
+    Q_OBJECT
+
+public:
+    QMixerSample(const QString &fileName, const QAudioFormat &format);
+
+    // false if the file couldn't be opened or decoding couldn't start
+    bool isValid() const { return m_valid; }
+    // true once everything there is to decode is in data()
+    bool isComplete() const { return m_complete.loadAcquire(); }
+    // once complete: whether decoding stopped on an error, and which
+    bool hasError() const { return m_decodeError != QAudioDecoder::NoError; }
+    int decodeError() const { return m_decodeError; }
+    QString errorString() const { return m_errorString; }
+
+    // the bytes decoded so far, readable from any thread
+    qint64 size() const;
+    qint64 read(qint64 pos, char *data, qint64 maxlen) const;
+    QAudioFormat format() const { return m_format; }
+
+Q_SIGNALS:
+    void dataAdded();
+    void finished();
+    void error(int error, const QString &errorString);
+
+private:
+    Q_INVOKABLE void start();
+    void bufferReady();
+    void decoderError(QAudioDecoder::Error error);
+    void decoderFinished();
+    void fail(QAudioDecoder::Error error, const QString &errorString);
+
+    QString m_fileName;
+    QFile m_file;
+    QAudioDecoder m_decoder;
+    QAudioFormat m_format;
+    QMixerSampleBuffer m_data;
+    // the disk cache entry we play from, if there is one
+    QFile m_cacheFile;
+    const char *m_mapped;
+    qint64 m_mappedSize;
+    QAtomicInt m_complete;
+    bool m_valid;
+    // written before m_complete is set, read after
+    int m_decodeError;
+    QString m_errorString;
+};
+
+// Process-wide cache of the samples in use, keyed by file and format.
+// Opening a file that is being played already shares its decoded data
+// instead of decoding it again; a sample goes away with its last user.
+// identifies a file decoded into a given format
+QString qMixerSampleKey(const QString &fileName, const QAudioFormat &format);
+
+class QMixerSampleBank
+{
+public:
+    static QSharedPointer<QMixerSample> sample(const QString &fileName, const QAudioFormat &format);
+    // drops sample, so that the next user of the file decodes it again
+    static void forget(const QString &fileName, const QAudioFormat &format, const QMixerSample *sample);
+};
+
+#endif // QMIXERSAMPLEBANK_P_H
@@ -0,0 +1,126 @@
+#include <cstring>
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QVector>
+
+#include "qmixersamplebuffer_p.h"
+
+namespace {
+
+// Recycles chunks between buffers, so that opening and closing streams
+// doesn't keep going back to the allocator for big blocks.
+class ChunkPool
+{
+public:
+    ~ChunkPool()
+    {
+        for (char *chunk : qAsConst(m_free)) {
+            delete[] chunk;
+        }
+    }
+
+    char *take()
+    {
+        QMutexLocker lock(&m_lock);
+        return m_free.isEmpty() ? new char[QMixerSampleBuffer::ChunkSize] : m_free.takeLast();
+    }
+
+    void give(char *chunk)
+    {
+        QMutexLocker lock(&m_lock);
+        if (m_free.size() < MaxFree) {
+            m_free.append(chunk);
+        } else {
+            delete[] chunk;
+        }
+    }
+
+private:
+    // keep at most 16 MiB around
+    enum { MaxFree = 256 };
+
+    QMutex m_lock;
+    QVector<char *> m_free;
+};
+
+Q_GLOBAL_STATIC(ChunkPool, chunkPool)
+
+} // namespace
+
+QMixerSampleBuffer::QMixerSampleBuffer()
+    : m_size(0)
+{
+    memset(m_directory, 0, sizeof(m_directory));
+}
+
+QMixerSampleBuffer::~QMixerSampleBuffer()
+{
+    clear();
+}
+
+qint64 QMixerSampleBuffer::append(const char *data, qint64 len)
+{
+    qint64 size = m_size.load();
+    const qint64 capacity = qint64(ChunkSize) * DirectorySize * DirectorySize;
+    len = qMin(len, capacity - size);
+
+    qint64 done = 0;
+    while (done < len) {
+        const qint64 index = size / ChunkSize;
+        const int offset = int(size % ChunkSize);
+        if (offset == 0) {
+            char **&table = m_directory[index / DirectorySize];
+            if (!table) {
+                table = new char *[DirectorySize];
+            }
+            table[index % DirectorySize] = chunkPool()->take();
+        }
+        const int n = int(qMin<qint64>(ChunkSize - offset, len - done));
+        memcpy(chunk(index) + offset, data + done, n);
+        size += n;
+        done += n;
+    }
+    // publishes the new chunks along with the data
+    m_size.storeRelease(size);
+
+    return done;
+}
+
+void QMixerSampleBuffer::clear()
+{
+    const int nChunks = chunkCount();
+    for (int i = 0; i < nChunks; ++i) {
+        chunkPool()->give(chunk(i));
+    }
+    for (char **&table : m_directory) {
+        delete[] table;
+        table = nullptr;
+    }
+    m_size.store(0);
+}
+
+int QMixerSampleBuffer::chunkCount() const
+{
+    return int((size() + ChunkSize - 1) / ChunkSize);
+}
+
+qint64 QMixerSampleBuffer::read(qint64 pos, char *data, qint64 maxlen) const
+{
+    const qint64 size = this->size();
+    if (pos < 0 || pos >= size) {
+        return 0;
+    }
+    maxlen = qMin(maxlen, size - pos);
+
+    qint64 done = 0;
+    while (done < maxlen) {
+        const int offset = int(pos % ChunkSize);
+        const int n = int(qMin<qint64>(ChunkSize - offset, maxlen - done));
+        memcpy(data + done, chunk(pos / ChunkSize) + offset, n);
+        pos += n;
+        done += n;
+    }
+
+    return done;
+}
@@ -0,0 +1,47 @@
+#ifndef QMIXERSAMPLEBUFFER_P_H
+#define QMIXERSAMPLEBUFFER_P_H
+
+#include <QAtomicInteger>
+
+// Append-only store for decoded PCM, made of fixed-size chunks taken from a
+// process-wide pool. Appending never moves what is stored already, so one
+// thread may append() while any number of others read(); readers only ever
+// see data up to the size() published by the last append().
+class QMixerSampleBuffer
+{
+public:
+    enum {
+        ChunkSize = 64 * 1024,
+        // the chunk directory has two fixed levels so that it never moves
+        // either; 256 * 256 chunks of 64 KiB allow for 4 GiB of audio
+        DirectorySize = 256
+    };
+
+    QMixerSampleBuffer();
+    ~QMixerSampleBuffer();
+
+    // writer side; returns the number of bytes stored, which is less than
+    // len only when the buffer is full
+    qint64 append(const char *data, qint64 len);
+    // gives the chunks back to the pool; no reader may be active
+    void clear();
+
+    qint64 size() const { return m_size.loadAcquire(); }
+    int chunkCount() const;
+    // copies up to maxlen bytes starting at offset pos into data and returns
+    // the number of bytes copied
+    qint64 read(qint64 pos, char *data, qint64 maxlen) const;
+
+private:
+    Q_DISABLE_COPY(QMixerSampleBuffer)
+
+    char *chunk(qint64 index) const
+    {
+        return m_directory[index / DirectorySize][index % DirectorySize];
+    }
+
+    char **m_directory[DirectorySize];
+    QAtomicInteger<qint64> m_size;
+};
+
+#endif // QMIXERSAMPLEBUFFER_P_H
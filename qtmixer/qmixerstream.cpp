@@ -1,25 +1,102 @@
+#include <climits>
+
 #include <QDebug>
 #include <QByteArray>
 #include <QAudioDecoder>
 #include <QBuffer>
+#include <QSaveFile>
+#include <QtEndian>
 
 #include "qmixerstream.h"
-#include "qaudiodecoderstream.h"
+#include "qmixerbackend.h"
 #include "qmixerstreamhandle.h"
 #include "qabstractmixerstream.h"
 #include "qmixerstream_p.h"
+#include "qmixerformat_p.h"
+#include "qmixerrenderthread_p.h"
+#include "qmixerdiskcache_p.h"
+#include "qmixerdecodepool_p.h"
+#include "qmixerinsert.h"
+
+namespace {
+
+enum {
+    WavePcm = 0x0001,
+    WaveFloat = 0x0003,
+    WaveHeaderSize = 44
+};
+
+// the sizes in the header are 32 bits wide, and the RIFF chunk's covers
+// the rest of the header and the padded data
+const qint64 MaxWaveDataSize = 0xffffffffLL - (WaveHeaderSize - 8) - 1;
+
+// the sample formats a WAV file can hold, see QPcmFileStream::parseWav()
+bool isWavFormat(const QAudioFormat &format)
+{
+    switch (format.sampleType()) {
+    case QAudioFormat::SignedInt:
+        return format.sampleSize() > 8;
+    case QAudioFormat::UnSignedInt:
+        return format.sampleSize() == 8;
+    case QAudioFormat::Float:
+        return format.sampleSize() == 32;
+    default:
+        return false;
+    }
+}
+
+// the canonical header, RIFX for big endian samples
+QByteArray wavHeader(const QAudioFormat &format, qint64 dataSize)
+{
+    const bool bigEndian = format.byteOrder() == QAudioFormat::BigEndian;
+    auto write16 = [bigEndian](char *p, quint16 value) {
+        bigEndian ? qToBigEndian(value, p) : qToLittleEndian(value, p);
+    };
+    auto write32 = [bigEndian](char *p, quint32 value) {
+        bigEndian ? qToBigEndian(value, p) : qToLittleEndian(value, p);
+    };
+
+    Q_ASSERT(dataSize >= 0 && dataSize <= MaxWaveDataSize);
+    const quint32 size = quint32(dataSize);
+    QByteArray header(WaveHeaderSize, '\0');
+    char *p = header.data();
+    memcpy(p, bigEndian ? "RIFX" : "RIFF", 4);
+    write32(p + 4, size + (size & 1) + WaveHeaderSize - 8);
+    memcpy(p + 8, "WAVEfmt ", 8);
+    write32(p + 16, 16);
+    write16(p + 20, format.sampleType() == QAudioFormat::Float ? WaveFloat : WavePcm);
+    write16(p + 22, quint16(format.channelCount()));
+    write32(p + 24, quint32(format.sampleRate()));
+    write32(p + 28, quint32(format.sampleRate() * format.bytesPerFrame()));
+    write16(p + 32, quint16(format.bytesPerFrame()));
+    write16(p + 34, quint16(format.sampleSize()));
+    memcpy(p + 36, "data", 4);
+    write32(p + 40, size);
+    return header;
+}
+
+} // namespace
 
 QMixerStream::QMixerStream(const QAudioFormat &format, QObject *parent)
     : QIODevice(parent)
     , d_ptr(new QMixerStreamPrivate(format))
 {
     setOpenMode(QIODevice::ReadOnly);
+
+    // streams may change state on the thread that does the mixing
+    qRegisterMetaType<QMixerStreamHandle>();
+    qRegisterMetaType<QtMixer::State>();
+
+    if (!d_ptr->m_kernels.isValid()) {
+        qWarning() << "QMixerStream: cannot mix format" << format << "- only a single stream will be played";
+    }
 }
 
 QMixerStream::~QMixerStream()
 {
     qWarning() << Q_FUNC_INFO << this;
     close();
+    delete d_ptr;
 }
 
 QAudioFormat QMixerStream::formatForFile(const QString &fileName)
@@ -42,15 +119,11 @@ bool QMixerStream::atEnd() const
     if (m_appendable) {
         qWarning() << this << "is appendable so never atEnd";
         return false;
-    } else if (Q_LIKELY(d_ptr->m_streams.size())) {
-        for (QAbstractMixerStream *stream : d_ptr->m_streams) {
-            if (!stream->atEnd()) {
-                return false;
-            }
-        }
     }
-    // return true for an invalid stream
-    return true;
+    // streams are dropped from the voice array once they stop or are at
+    // their end, so we are done when it is empty and nothing new is on its way.
+    // This is also true for an invalid stream.
+    return !d_ptr->m_streamCount.load() && d_ptr->m_commands.isEmpty();
 }
 
 bool QMixerStream::isSequential() const
@@ -63,48 +136,504 @@ void QMixerStream::setAppendable(bool enabled)
     m_appendable = enabled;
 }
 
-QMixerStreamHandle QMixerStream::openStream(const QString &fileName)
+QtMixer::MixMode QMixerStream::mixMode() const
+{
+    return QtMixer::MixMode(d_ptr->m_mixMode.load());
+}
+
+void QMixerStream::setMixMode(QtMixer::MixMode mode)
 {
-    QAudioDecoderStream *stream = new QAudioDecoderStream(fileName, d_ptr->m_format);
+    d_ptr->m_mixMode.store(mode);
+}
+
+float QMixerStream::peakLevel() const
+{
+    return qMixerBitsFloat(d_ptr->m_peakLevel.loadAcquire());
+}
+
+float QMixerStream::rmsLevel() const
+{
+    return qMixerBitsFloat(d_ptr->m_rmsLevel.loadAcquire());
+}
+
+QMixerStatistics QMixerStream::statistics() const
+{
+    const QMixerStreamPrivate *d = d_ptr;
+    QMixerStatistics statistics;
+    statistics.callbacks = d->m_callbacks.load();
+    statistics.blocks = d->m_blocks.load();
+    const qint64 mixTime = d->m_mixTime.load();
+    statistics.minBlockTime = d->m_minBlockTime.load() / 1000;
+    statistics.averageBlockTime = statistics.blocks ? mixTime / qint64(statistics.blocks) / 1000 : 0;
+    statistics.maxBlockTime = d->m_maxBlockTime.load() / 1000;
+    statistics.blockTimeHistogram.resize(QMixerStreamPrivate::HistogramBuckets);
+    for (int i = 0; i < QMixerStreamPrivate::HistogramBuckets; ++i) {
+        statistics.blockTimeHistogram[i] = d->m_histogram[i].load();
+    }
+    const qint64 frames = d->m_mixedFrames.load();
+    statistics.dspLoad = frames ? float(double(mixTime) * d->m_format.sampleRate() / (double(frames) * 1e9)) : 0.0f;
+    statistics.maxDspLoad = qMixerBitsFloat(d->m_maxDspLoad.load());
+    statistics.activeVoices = d->m_activeVoices.load();
+    statistics.underruns = d->m_underruns.load();
+    statistics.shortReads = d->m_shortReads.load();
+    for (QAbstractMixerStream *stream : d->m_streams) {
+        const qint64 backlog = stream->decodeBacklog();
+        if (backlog >= 0) {
+            statistics.decodeBacklog.append({QMixerStreamHandle(stream), backlog});
+        }
+    }
+    return statistics;
+}
+
+void QMixerStream::resetStatistics()
+{
+    if (!d_ptr->post({QMixerCommand::ResetStatistics, nullptr, 0, 0, 0, nullptr, nullptr, nullptr})) {
+        qWarning() << Q_FUNC_INFO << "command queue full, can't reset the statistics";
+    }
+    d_ptr->m_callbacks.store(0);
+    d_ptr->m_underruns.store(0);
+}
+
+qint64 QMixerStream::renderOffline(char *data, qint64 frames)
+{
+    const int frameBytes = d_ptr->m_format.bytesPerFrame();
+    if (d_ptr->m_renderThread || !frameBytes || frames < 0) {
+        qWarning() << Q_FUNC_INFO << "can't render offline";
+        return -1;
+    }
+    const qint64 n = d_ptr->renderOffline(data, frames * frameBytes, false);
+    return n < 0 ? -1 : n / frameBytes;
+}
+
+QByteArray QMixerStream::renderOffline(qint64 frames)
+{
+    QByteArray data;
+    const int frameBytes = d_ptr->m_format.bytesPerFrame();
+    if (frames >= 0 && frameBytes) {
+        if (frames > INT_MAX / frameBytes) {
+            qWarning() << Q_FUNC_INFO << frames << "frames don't fit in a QByteArray, use renderOfflineTo()";
+            return data;
+        }
+        data.resize(int(frames * frameBytes));
+        if (renderOffline(data.data(), frames) < 0) {
+            data.clear();
+        }
+        return data;
+    }
+
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    if (renderOfflineTo(&buffer, -1) < 0) {
+        data.clear();
+    }
+    return data;
+}
+
+qint64 QMixerStream::renderOfflineTo(QIODevice *device, qint64 frames)
+{
+    const int frameBytes = d_ptr->m_format.bytesPerFrame();
+    if (d_ptr->m_renderThread || !frameBytes || !device || !device->isWritable()) {
+        qWarning() << Q_FUNC_INFO << "can't render offline";
+        return -1;
+    }
+
+    QByteArray buffer(QMixerStreamPrivate::OfflineBlockFrames * frameBytes, Qt::Uninitialized);
+    qint64 written = 0;
+    while (frames < 0 || written < frames) {
+        const qint64 len = frames < 0 ? buffer.size()
+                           : qMin<qint64>(buffer.size(), (frames - written) * frameBytes);
+        const qint64 n = d_ptr->renderOffline(buffer.data(), len, frames < 0);
+        if (n < 0) {
+            return -1;
+        }
+        if (n > 0 && device->write(buffer.constData(), n) != n) {
+            qWarning() << Q_FUNC_INFO << "write error:" << device->errorString();
+            return -1;
+        }
+        written += n / frameBytes;
+        if (n < len) {
+            break;
+        }
+    }
+    return written;
+}
+
+bool QMixerStream::renderOfflineToWav(const QString &fileName, qint64 frames)
+{
+    const QAudioFormat &format = d_ptr->m_format;
+    if (!isWavFormat(format)) {
+        qWarning() << Q_FUNC_INFO << "WAV files can't hold" << format;
+        return false;
+    }
+    if (frames > MaxWaveDataSize / qMax(1, format.bytesPerFrame())) {
+        qWarning() << Q_FUNC_INFO << frames << "frames don't fit in a WAV file";
+        return false;
+    }
+
+    // written to a temporary file and only renamed into place when complete
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << Q_FUNC_INFO << "can't write" << fileName << file.errorString();
+        return false;
+    }
+    // the sizes are filled in once they are known
+    file.write(wavHeader(format, 0));
+    const qint64 rendered = renderOfflineTo(&file, frames);
+    if (rendered < 0) {
+        file.cancelWriting();
+        return false;
+    }
+    const qint64 dataSize = rendered * format.bytesPerFrame();
+    if (dataSize > MaxWaveDataSize) {
+        // rendered until done, and that came to more than 4 GiB
+        qWarning() << Q_FUNC_INFO << "the mix is too long for a WAV file," << rendered << "frames";
+        file.cancelWriting();
+        return false;
+    }
+    if (dataSize & 1) {
+        // chunks are padded to an even size
+        file.putChar('\0');
+    }
+    file.seek(0);
+    file.write(wavHeader(format, dataSize));
+    return file.commit();
+}
+
+bool QMixerStream::limiterEnabled() const
+{
+    return d_ptr->m_limiterEnabled;
+}
+
+void QMixerStream::setLimiterEnabled(bool enabled)
+{
+    d_ptr->m_limiterEnabled = enabled;
+    d_ptr->updateLimiter();
+}
+
+int QMixerStream::limiterLookahead() const
+{
+    return d_ptr->m_limiterLookahead;
+}
+
+void QMixerStream::setLimiterLookahead(int milliseconds)
+{
+    d_ptr->m_limiterLookahead = qMax(milliseconds, 0);
+    d_ptr->updateLimiter();
+}
+
+int QMixerStream::limiterRelease() const
+{
+    return d_ptr->m_limiterRelease;
+}
+
+void QMixerStream::setLimiterRelease(int milliseconds)
+{
+    d_ptr->m_limiterRelease = qMax(milliseconds, 1);
+    d_ptr->updateLimiter();
+}
+
+qint64 QMixerStream::frameClock() const
+{
+    return d_ptr->m_frameClock.loadAcquire();
+}
+
+int QMixerStream::maxVoices() const
+{
+    return d_ptr->m_maxVoices.load();
+}
+
+void QMixerStream::setMaxVoices(int voices)
+{
+    d_ptr->m_maxVoices.store(qMax(voices, 0));
+}
+
+QtMixer::StealPolicy QMixerStream::stealPolicy() const
+{
+    return QtMixer::StealPolicy(d_ptr->m_stealPolicy.load());
+}
+
+void QMixerStream::setStealPolicy(QtMixer::StealPolicy policy)
+{
+    d_ptr->m_stealPolicy.store(policy);
+}
+
+bool QMixerStream::renderThreadEnabled() const
+{
+    return d_ptr->m_renderThread != nullptr;
+}
+
+void QMixerStream::setRenderThreadEnabled(bool enabled)
+{
+    if (enabled) {
+        d_ptr->startRenderThread();
+    } else {
+        d_ptr->stopRenderThread();
+    }
+}
+
+int QMixerStream::renderBufferDuration() const
+{
+    return d_ptr->m_renderBufferDuration;
+}
+
+void QMixerStream::setRenderBufferDuration(int milliseconds)
+{
+    if (milliseconds > 0 && milliseconds != d_ptr->m_renderBufferDuration) {
+        d_ptr->m_renderBufferDuration = milliseconds;
+        if (d_ptr->m_renderThread) {
+            // restart with a ring of the new size
+            d_ptr->stopRenderThread();
+            d_ptr->startRenderThread();
+        }
+    }
+}
+
+int QMixerStream::underruns() const
+{
+    return d_ptr->m_underruns.load();
+}
+
+int QMixerStream::streamingBufferDuration() const
+{
+    return d_ptr->m_streamingBufferDuration;
+}
+
+void QMixerStream::setStreamingBufferDuration(int milliseconds)
+{
+    if (milliseconds > 0) {
+        d_ptr->m_streamingBufferDuration = milliseconds;
+    }
+}
+
+int QMixerStream::prerollDuration() const
+{
+    return d_ptr->m_prerollDuration;
+}
+
+void QMixerStream::setPrerollDuration(int milliseconds)
+{
+    if (milliseconds >= 0) {
+        d_ptr->m_prerollDuration = milliseconds;
+        d_ptr->m_prerollBytes.storeRelease(d_ptr->m_format.bytesForDuration(qint64(milliseconds) * 1000));
+    }
+}
+
+QString QMixerStream::diskCacheDirectory()
+{
+    return QMixerDiskCache::directory();
+}
+
+void QMixerStream::setDiskCacheDirectory(const QString &directory)
+{
+    QMixerDiskCache::setDirectory(directory);
+}
+
+qint64 QMixerStream::diskCacheSize()
+{
+    return QMixerDiskCache::maximumSize();
+}
+
+void QMixerStream::setDiskCacheSize(qint64 bytes)
+{
+    QMixerDiskCache::setMaximumSize(bytes);
+}
+
+int QMixerStream::decodeThreadCount()
+{
+    return QMixerDecodePool::threadCount();
+}
+
+void QMixerStream::setDecodeThreadCount(int count)
+{
+    QMixerDecodePool::setThreadCount(count);
+}
+
+QMixerStreamHandle QMixerStream::openStream(const QString &fileName, QtMixer::DecodeMode mode)
+{
+    QAbstractMixerStream *stream = QMixerBackend::createStream(fileName, d_ptr->m_format,
+                                                               mode, d_ptr->m_streamingBufferDuration);
     QMixerStreamHandle handle(stream);
     if (stream) {
+        stream->m_mixer = d_ptr;
+        if (!stream->post({QMixerCommand::Add, stream, 0, 0, 0, nullptr, nullptr, nullptr})) {
+            // the mixing thread never heard of it
+            delete stream;
+            return QMixerStreamHandle();
+        }
         d_ptr->m_streams << stream;
 
         connect(stream, &QAbstractMixerStream::stateChanged, this, &QMixerStream::stateChanged);
         connect(stream, &QAbstractMixerStream::decodingFinished, this, &QMixerStream::decodingFinished);
         connect(stream, &QAbstractMixerStream::readyRead, this, &QMixerStream::readyRead);
+
+        connect(stream, &QAbstractMixerStream::ready, this, &QMixerStream::streamReady);
+        connect(stream, &QAbstractMixerStream::readyRead, stream, &QAbstractMixerStream::updateReady);
+        connect(stream, &QAbstractMixerStream::decodingFinished, stream, &QAbstractMixerStream::updateReady);
+        // the pre-roll may be there already, but our caller has yet to connect
+        QMetaObject::invokeMethod(stream, "updateReady", Qt::QueuedConnection);
     }
 
     return handle;
 }
 
-void QMixerStream::closeStream(const QMixerStreamHandle &handle)
+bool QMixerStream::closeStream(const QMixerStreamHandle &handle)
 {
     QAbstractMixerStream *stream = handle.m_stream;
 
-    if (stream) {
-        stream->stop();
-        stream->removeFrom(d_ptr->m_streams);
-        stream->deleteLater();
+    if (!stream || !d_ptr->m_streams.contains(stream)) {
+        return false;
+    }
+    // the mixing thread stops and deletes it; if the command doesn't get
+    // through, the stream stays open so that the caller can try again
+    if (!stream->remove()) {
+        return false;
+    }
+    d_ptr->m_streams.removeAll(stream);
+    return true;
+}
+
+bool QMixerStream::addBus(const QString &name, const QString &parent)
+{
+    const int parentIndex = parent.isEmpty() ? 0 : d_ptr->busIndex(parent);
+    if (name.isEmpty() || d_ptr->busIndex(name) >= 0 || parentIndex < 0) {
+        return false;
+    }
+    d_ptr->freeRetired();
+    for (int i = 1; i < QMixerStreamPrivate::MaxBuses; ++i) {
+        QMixerBusInfo &info = d_ptr->m_busInfo[i];
+        if (info.name.isEmpty()) {
+            // allocated here rather than by the mixing thread, as large as the
+            // blocks so far; only a larger block makes that grow it
+            const int samples = qMax(d_ptr->m_blockSamples.load(),
+                                     QMixerStreamPrivate::OfflineBlockFrames * d_ptr->m_format.channelCount());
+            QVector<float> *buffer = new QVector<float>(samples);
+            if (!d_ptr->post({QMixerCommand::AddBus, nullptr, i, 0, parentIndex, nullptr, nullptr, buffer})) {
+                qWarning() << Q_FUNC_INFO << "command queue full, can't add bus" << name;
+                delete buffer;
+                return false;
+            }
+            info = {name, parentIndex, 1.0f, false};
+            return true;
+        }
+    }
+    qWarning() << Q_FUNC_INFO << "no bus left for" << name;
+    return false;
+}
+
+bool QMixerStream::removeBus(const QString &name)
+{
+    d_ptr->freeRetired();
+    const int index = d_ptr->busIndex(name);
+    if (index <= 0) {
+        // the master bus stays
+        return false;
+    }
+    // the streams move first, so that none is left feeding a bus that's gone;
+    // those that did move are fine in the parent if the rest doesn't work out
+    const int parent = d_ptr->m_busInfo.at(index).parent;
+    for (QAbstractMixerStream *stream : qAsConst(d_ptr->m_streams)) {
+        if (stream->m_routedBus == index) {
+            if (!stream->post({QMixerCommand::SetBus, stream, parent, 0, 0, nullptr, nullptr, nullptr})) {
+                qWarning() << Q_FUNC_INFO << "command queue full, can't remove bus" << name;
+                return false;
+            }
+            stream->m_routedBus = parent;
+        }
+    }
+    if (!d_ptr->post({QMixerCommand::RemoveBus, nullptr, index, 0, 0, nullptr, nullptr, nullptr})) {
+        qWarning() << Q_FUNC_INFO << "command queue full, can't remove bus" << name;
+        return false;
+    }
+    for (QMixerBusInfo &info : d_ptr->m_busInfo) {
+        if (info.parent == index) {
+            info.parent = parent;
+        }
+    }
+    d_ptr->m_busInfo[index] = {QString(), -1, 1.0f, false};
+    return true;
+}
+
+QStringList QMixerStream::buses() const
+{
+    QStringList names;
+    for (const QMixerBusInfo &info : qAsConst(d_ptr->m_busInfo)) {
+        if (!info.name.isEmpty()) {
+            names << info.name;
+        }
+    }
+    return names;
+}
+
+float QMixerStream::busGain(const QString &name) const
+{
+    const int index = d_ptr->busIndex(name);
+    return index >= 0 ? d_ptr->m_busInfo.at(index).gain : 0.0f;
+}
+
+bool QMixerStream::setBusGain(const QString &name, float gain)
+{
+    const int index = d_ptr->busIndex(name);
+    if (index < 0) {
+        return false;
+    }
+    if (!d_ptr->post({QMixerCommand::SetBusGain, nullptr, index, gain, 0, nullptr, nullptr, nullptr})) {
+        qWarning() << Q_FUNC_INFO << "command queue full, can't set the gain of bus" << name;
+        return false;
+    }
+    d_ptr->m_busInfo[index].gain = gain;
+    return true;
+}
+
+bool QMixerStream::isBusMuted(const QString &name) const
+{
+    const int index = d_ptr->busIndex(name);
+    return index >= 0 && d_ptr->m_busInfo.at(index).muted;
+}
+
+bool QMixerStream::setBusMuted(const QString &name, bool muted)
+{
+    const int index = d_ptr->busIndex(name);
+    if (index < 0) {
+        return false;
+    }
+    if (!d_ptr->post({QMixerCommand::SetBusMuted, nullptr, index, 0, muted, nullptr, nullptr, nullptr})) {
+        qWarning() << Q_FUNC_INFO << "command queue full, can't mute bus" << name;
+        return false;
+    }
+    d_ptr->m_busInfo[index].muted = muted;
+    return true;
+}
+
+void QMixerStream::setBusInsert(const QString &name, QMixerInsert *insert)
+{
+    d_ptr->freeRetired();
+    const int index = d_ptr->busIndex(name);
+    if (index < 0 || !d_ptr->post({QMixerCommand::SetBusInsert, nullptr, index, 0, 0, insert, nullptr, nullptr})) {
+        qWarning() << Q_FUNC_INFO << "can't set the insert of bus" << name;
+        delete insert;
     }
 }
 
 void QMixerStream::close()
 {
     emit aboutToClose();
-    const QList<QAbstractMixerStream *> streams = d_ptr->m_streams;
-    for (QAbstractMixerStream *stream : streams) {
-        stream->stop();
-        stream->removeFrom(d_ptr->m_streams);
-        stream->deleteLater();
+    d_ptr->stopRenderThread();
+
+    // the removals are carried out by whichever thread mixes next, or by the
+    // destructor; the streams whose command doesn't get through stay open
+    QList<QAbstractMixerStream *> streams;
+    for (QAbstractMixerStream *stream : qAsConst(d_ptr->m_streams)) {
+        if (!stream->remove()) {
+            streams << stream;
+        }
     }
+    d_ptr->m_streams = streams;
 }
 
 qint64 QMixerStream::size() const
 {
     qint64 size = 0, N = 0;
-    const QList<QAbstractMixerStream *> streams = d_ptr->m_streams;
-    for (QAbstractMixerStream *stream : streams) {
+    for (QAbstractMixerStream *stream : qAsConst(d_ptr->m_streams)) {
         if (!stream->atEnd()) {
             size += stream->length();
             N += 1;
@@ -115,46 +644,35 @@ qint64 QMixerStream::size() const
 
 qint64 QMixerStream::readData(char *data, qint64 maxlen)
 {
-    if (Q_UNLIKELY(!d_ptr->m_streams.size())) {
-        return 0;
+    d_ptr->m_callbacks.ref();
+    // lets a render thread switch know when we are done with the old mode
+    d_ptr->m_readers.ref();
+    if (!d_ptr->m_useRing.loadAcquire()) {
+        const qint64 n = d_ptr->mix(data, maxlen);
+        d_ptr->m_readers.deref();
+        return n;
     }
 
-    const QList<QAbstractMixerStream *> streams = d_ptr->m_streams;
-    const int nStreams = streams.size();
-
-    if (nStreams == 1) {
-        // 1 stream only, fast codepath
-        QAbstractMixerStream *stream = streams.at(0);
-        maxlen = stream->readData(data, maxlen);
-        if (stream->atEnd()) {
-            stream->stop();
-            stream->removeFrom(d_ptr->m_streams);
-        }
+    // the render thread did all the work already
+    qint64 n = d_ptr->m_ring.read(data, int(qMin<qint64>(maxlen, INT_MAX)));
+    bool starting = false;
+    if (n < maxlen && d_ptr->m_streamCount.load()) {
+        // it didn't keep up: play silence rather than stall the device
+        memset(data + n, 0, maxlen - n);
+        n = maxlen;
+        d_ptr->m_underruns.ref();
+        starting = !d_ptr->m_underrunning;
+        d_ptr->m_underrunning = true;
     } else {
-        memset(data, 0, maxlen);
-        const qint16 depth = sizeof(qint16);
-        const qint16 samples = maxlen / depth;
-        qint64 nRead = 0;
-        for (QAbstractMixerStream *stream : streams) {
-            qint16 *cursor = reinterpret_cast<qint16 *>(data);
-            qint16 sample;
-
-            for (int i = 0; i < samples; i++, cursor++) {
-                if (qint64 n = stream->read((char *)&sample, depth)) {
-                    nRead += n;
-                    *cursor = mix(*cursor, sample);
-                }
-            }
-
-            if (stream->atEnd()) {
-                stream->stop();
-                stream->removeFrom(d_ptr->m_streams);
-            }
-        }
-        maxlen = nRead / nStreams;
+        d_ptr->m_underrunning = false;
     }
+    d_ptr->m_readers.deref();
 
-    return maxlen;
+    if (starting) {
+        // only now, a slot may well switch the render thread off
+        emit underrun();
+    }
+    return n;
 }
 
 qint64 QMixerStream::writeData(const char *data, qint64 len)
@@ -164,18 +682,3 @@ qint64 QMixerStream::writeData(const char *data, qint64 len)
 
     return 0;
 }
-
-qint16 QMixerStream::mix(qint32 sample1, qint32 sample2)
-{
-    const qint32 result = sample1 + sample2;
-
-    if (Range::max() < result) {
-        return Range::max();
-    }
-
-    if (Range::min() > result) {
-        return Range::min();
-    }
-
-    return result;
-}
@@ -3,13 +3,52 @@
 
 #include <QIODevice>
 #include <QAudioFormat>
+#include <QStringList>
+#include <QVector>
 
 #include "qtmixer.h"
 #include "qmixerstreamhandle.h"
 
-typedef std::numeric_limits<qint16> Range;
-
 class QMixerStreamPrivate;
+class QMixerInsert;
+
+// A snapshot of QMixerStream::statistics(). The counters run from the
+// creation of the mixer or the last resetStatistics(); the fields are
+// sampled one by one, so they may be a block apart.
+struct QMixerStatistics
+{
+    // readData() calls
+    quint64 callbacks;
+    // mix passes, in readData() or on the render thread, and the time they
+    // took in microseconds; 0 before the first one
+    quint64 blocks;
+    qint64 minBlockTime;
+    qint64 averageBlockTime;
+    qint64 maxBlockTime;
+    // blockTimeHistogram[0] counts the blocks that took under 1 us,
+    // blockTimeHistogram[i] those that took [2^(i-1), 2^i) us; the last
+    // bucket is open ended
+    QVector<quint64> blockTimeHistogram;
+    // time spent mixing over the duration of the audio mixed, on average and
+    // for the worst block; over 1 the mixer can't keep up in real time
+    float dspLoad;
+    float maxDspLoad;
+    // the streams that played in the last block
+    int activeVoices;
+    // see QMixerStream::underruns()
+    int underruns;
+    // renders of a playing stream that came up short, the decoder lagging behind
+    quint64 shortReads;
+
+    // the decoded audio ready ahead of the play position, in frames, for the
+    // streams that decode ahead
+    struct Backlog
+    {
+        QMixerStreamHandle stream;
+        qint64 frames;
+    };
+    QVector<Backlog> decodeBacklog;
+};
 
 class QTMIXER_EXPORT QMixerStream : public QIODevice
 {
@@ -19,9 +58,63 @@ public:
     QMixerStream(const QAudioFormat &format, QObject *parent=nullptr);
     ~QMixerStream();
 
-    QMixerStreamHandle openStream(const QString &fileName);
-
-    void closeStream(const QMixerStreamHandle &handle);
+    // see QtMixer::DecodeMode for the choice between keeping the decoded file
+    // in memory and streaming it; streams keep streamingBufferDuration()
+    // milliseconds (2000 by default) of decoded audio ready when streaming
+    QMixerStreamHandle openStream(const QString &fileName,
+                                  QtMixer::DecodeMode mode = QtMixer::CachedDecode);
+    int streamingBufferDuration() const;
+    void setStreamingBufferDuration(int milliseconds);
+
+    // Streams start decoding as soon as they are opened; streamReady() is
+    // emitted once prerollDuration() milliseconds (200 by default) of a stream
+    // are decoded, or all of it when it is shorter. Playing it from then on
+    // doesn't start with silence or drop out while the decoder gets going.
+    // Streams that need no decoding become ready right away, but the signal
+    // is always emitted from the event loop, never from openStream().
+    int prerollDuration() const;
+    void setPrerollDuration(int milliseconds);
+
+    // Files decoded in QtMixer::CachedDecode mode can be kept in a cache
+    // directory, so that the next run maps them instead of decoding them again.
+    // Disabled (empty directory) by default. The least recently used entries are
+    // removed beyond diskCacheSize() bytes, 256 MiB by default.
+    // These settings are shared by all mixers.
+    static QString diskCacheDirectory();
+    static void setDiskCacheDirectory(const QString &directory);
+    static qint64 diskCacheSize();
+    static void setDiskCacheSize(qint64 bytes);
+
+    // Decoding runs on a pool of decodeThreadCount() worker threads, shared by
+    // all mixers; by default as many as there are cores, up to 4.
+    // Changing it only affects the files opened afterwards.
+    static int decodeThreadCount();
+    static void setDecodeThreadCount(int count);
+
+    // Returns false if the handle isn't open in this mixer, or when the
+    // mixer is too busy to take the request; the stream stays open then.
+    bool closeStream(const QMixerStreamHandle &handle);
+
+    // Submix buses: named groups that streams are routed into (see
+    // QMixerStreamHandle::setBus()), each with its own gain, mute and insert
+    // effect. Buses feed the bus they were added under, the "master" bus by
+    // default, which always exists; gain changes are ramped over a block.
+    // Removing a bus reroutes its streams and buses to its parent. Up to 31
+    // buses besides the master bus; while any are used the mix goes through
+    // float buffers, as in QtMixer::FloatMix mode.
+    // The changes return false for an unknown bus, or when the mixer is too
+    // busy to take them; nothing changes then.
+    bool addBus(const QString &name, const QString &parent = QString());
+    bool removeBus(const QString &name);
+    QStringList buses() const;
+    float busGain(const QString &name) const;
+    bool setBusGain(const QString &name, float gain);
+    bool isBusMuted(const QString &name) const;
+    bool setBusMuted(const QString &name, bool muted = true);
+    // takes ownership; replaces the previous insert, which is deleted on
+    // this thread by a later bus change or with the mixer, never while it
+    // is in use. Pass nullptr to remove it.
+    void setBusInsert(const QString &name, QMixerInsert *insert);
 
     // doesn't seem to work/possible?
     static QAudioFormat formatForFile(const QString &fileName);
@@ -36,13 +129,89 @@ public:
     bool appendable() const { return m_appendable; }
     void setAppendable(bool enabled = true);
 
+    // how the streams are summed, see QtMixer::MixMode; SaturatingMix by default
+    QtMixer::MixMode mixMode() const;
+    void setMixMode(QtMixer::MixMode mode);
+
+    // The level of the mix in the last block, measured as a by-product of
+    // mixing: the largest sample magnitude and the RMS, 1 being full scale.
+    // A peak over 1 means the output clipped. Can be read from any thread.
+    float peakLevel() const;
+    float rmsLevel() const;
+
+    // A look-ahead peak limiter on the master output, off by default. Instead
+    // of clipping a sum that goes over full scale it turns the gain down
+    // smoothly, ahead of the peak, and back up over limiterRelease()
+    // milliseconds (100 by default). This delays the output by
+    // limiterLookahead() milliseconds (5 by default); frameClock() doesn't
+    // account for that. The mix goes through float buffers while it is on.
+    bool limiterEnabled() const;
+    void setLimiterEnabled(bool enabled = true);
+    int limiterLookahead() const;
+    void setLimiterLookahead(int milliseconds);
+    int limiterRelease() const;
+    void setLimiterRelease(int milliseconds);
+
+    // The most streams that play at once, 64 by default, 0 for no limit; it
+    // bounds the work done per block. Either way the mixer holds no more than
+    // 256 streams that are playing, paused or waiting for playAt(). Playing one more makes the stream chosen
+    // by stealPolicy() (StealOldest by default) fade out over one block and
+    // stop, or, if all the playing streams have a higher priority, doesn't
+    // play it at all.
+    int maxVoices() const;
+    void setMaxVoices(int voices);
+    QtMixer::StealPolicy stealPolicy() const;
+    void setStealPolicy(QtMixer::StealPolicy policy);
+
+    // Mix ahead of time on a dedicated high priority thread instead of in
+    // whichever thread the audio output pulls from; readData() then only copies
+    // already rendered audio. The thread keeps renderBufferDuration() milliseconds
+    // (100 by default) of audio ready. Whenever readData() has to pad with
+    // silence because the thread didn't keep up, underruns() is incremented;
+    // underrun() is emitted at the start of each such episode.
+    bool renderThreadEnabled() const;
+    void setRenderThreadEnabled(bool enabled = true);
+    int renderBufferDuration() const;
+    void setRenderBufferDuration(int milliseconds);
+    int underruns() const;
+
+    // The number of frames mixed so far, the clock QMixerStreamHandle::playAt()
+    // and stopAt() refer to. It runs ahead of what is heard by the audio
+    // output's buffer, and by renderBufferDuration() with the render thread.
+    qint64 frameClock() const;
+
+    // Timings and counters of the audio path, kept with plain atomic stores
+    // by the threads that mix; cheap enough to leave on in production.
+    // Resetting also resets underruns().
+    QMixerStatistics statistics() const;
+    void resetStatistics();
+
+    // Offline rendering: mixes on the calling thread as fast as it can instead
+    // of at the pace of an audio output, which must not be pulling from the
+    // mixer meanwhile; not available while the render thread is enabled.
+    // Before each block it waits for the decoders of the streams playing in
+    // it, so that none of them comes out short. Streams are set up and
+    // started as usual beforehand, playAt() and stopAt() included, and the
+    // frameClock() advances as it would in real time.
+    // frames -1 renders until no stream is playing or scheduled any more.
+    //
+    // Fails when a decoder doesn't provide the next block within 10 seconds.
+    //
+    // into data, which holds frames frames; returns the frames rendered, -1 on error
+    qint64 renderOffline(char *data, qint64 frames);
+    // empty on error, or when the frames don't fit in a QByteArray
+    QByteArray renderOffline(qint64 frames = -1);
+    // returns the frames written, -1 on error
+    qint64 renderOfflineTo(QIODevice *device, qint64 frames = -1);
+    // the file gets the mixer format, which has to be one WAV files can hold;
+    // fails for mixes over the 4 GiB its 32 bit sizes can describe
+    bool renderOfflineToWav(const QString &fileName, qint64 frames = -1);
+
 protected:
     qint64 readData(char *data, qint64 maxlen) override;
     qint64 writeData(const char *data, qint64 len) override;
 
 private:
-    qint16 mix(qint32 sample1, qint32 sample2);
-
     QMixerStreamPrivate *d_ptr;
 
     bool m_appendable = false;
@@ -50,6 +219,8 @@ private:
 Q_SIGNALS:
     void stateChanged(QMixerStreamHandle handle, QtMixer::State state);
     void decodingFinished(QMixerStreamHandle handle);
+    void streamReady(QMixerStreamHandle handle);
+    void underrun();
 };
 
 #endif // QMIXERSTREAM_H
@@ -1,7 +1,941 @@
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+#include <QDebug>
+#include <QThread>
+#include <QtAlgorithms>
+
 #include "qmixerstream_p.h"
+#include "qmixerrenderthread_p.h"
+#include "qabstractmixerstream.h"
+#include "qmixerinsert.h"
+#include "qmixerkernels_p.h"
+
+namespace {
+
+// The gain of a channel for a stream's gain and pan. Panning only affects the
+// first two channels, following the balance law: the centre keeps both at
+// unity, so that an unpanned stream is left untouched.
+inline float channelGain(float gain, float pan, int channel, int channels)
+{
+    if (channels < 2 || channel > 1) {
+        return gain;
+    }
+    return gain * (channel == 0 ? qMin(1.0f, 1.0f - pan) : qMin(1.0f, 1.0f + pan));
+}
+
+} // namespace
 
 QMixerStreamPrivate::QMixerStreamPrivate(const QAudioFormat &format)
-    : m_format(format)
+    : m_streamCount(0)
+    , m_maxVoices(64)
+    , m_stealPolicy(QtMixer::StealOldest)
+    , m_playCount(0)
+    , m_peakLevel(0)
+    , m_rmsLevel(0)
+    , m_frameClock(0)
+    , m_commands(1024)
+    , m_format(format)
+    , m_kernels(qMixerFormatKernels(format))
+    , m_mixMode(QtMixer::SaturatingMix)
+    , m_buses(MaxBuses)
+    , m_busCount(0)
+    , m_submix(false)
+    , m_busInfo(MaxBuses)
+    , m_limiterEnabled(false)
+    , m_limiterLookahead(5)
+    , m_limiterRelease(100)
+    , m_limiter(nullptr)
+    , m_retired(1024)
+    , m_blockSamples(0)
+    , m_callbacks(0)
+    , m_blocks(0)
+    , m_mixTime(0)
+    , m_minBlockTime(0)
+    , m_maxBlockTime(0)
+    , m_mixedFrames(0)
+    , m_maxDspLoad(0)
+    , m_activeVoices(0)
+    , m_shortReads(0)
+    , m_renderThread(nullptr)
+    , m_useRing(0)
+    , m_readers(0)
+    , m_renderBufferDuration(100)
+    , m_underruns(0)
+    , m_underrunning(false)
+    , m_streamingBufferDuration(2000)
+    , m_prerollDuration(200)
+    , m_prerollBytes(format.bytesForDuration(200 * 1000))
+{
+    // all the room there will ever be, so that adding a voice never
+    // allocates in the audio callback
+    m_voices.reserve(VoiceCapacity);
+
+    for (int i = 0; i < MaxBuses; ++i) {
+        m_buses[i] = {false, -1, 1.0f, false, 1.0f, nullptr, QVector<float>(), false};
+        m_busInfo[i] = {QString(), -1, 1.0f, false};
+    }
+    m_buses[0].live = true;
+    m_busInfo[0].name = QStringLiteral("master");
+    sortBuses();
+    m_clock.start();
+}
+
+QMixerStreamPrivate::~QMixerStreamPrivate()
+{
+    stopRenderThread();
+    // nothing is mixing any more, so carry out the pending removals here
+    processCommands();
+    for (const QMixerBus &bus : qAsConst(m_buses)) {
+        delete bus.insert;
+    }
+    delete m_limiter;
+    freeRetired();
+}
+
+bool QMixerStreamPrivate::post(const QMixerCommand &command)
+{
+    return m_commands.push(command);
+}
+
+void QMixerStreamPrivate::processCommands()
+{
+    QMixerCommand command;
+    while (m_commands.pop(command)) {
+        QAbstractMixerStream *stream = command.stream;
+        if (stream && stream->m_removed.loadAcquire() && command.type != QMixerCommand::Remove) {
+            // closed: it must not get a voice again, it is being deleted
+            continue;
+        }
+        switch (command.type) {
+        case QMixerCommand::AddBus:
+        case QMixerCommand::RemoveBus:
+        case QMixerCommand::SetBusGain:
+        case QMixerCommand::SetBusMuted:
+        case QMixerCommand::SetBusInsert:
+            executeBusCommand(command);
+            break;
+        case QMixerCommand::ResetStatistics:
+            resetStatistics();
+            break;
+        case QMixerCommand::SetLimiter:
+            if (m_limiter) {
+                retire({QMixerCommand::SetLimiter, nullptr, 0, 0, 0, nullptr, m_limiter, nullptr});
+            }
+            m_limiter = command.limiter;
+            break;
+        case QMixerCommand::Add:
+            // a stream only takes a voice once it is played
+            break;
+        case QMixerCommand::Remove:
+            stream->m_removed.storeRelease(1);
+            stream->stop();
+            if (stream->m_voice >= 0) {
+                removeVoice(stream->m_voice);
+            }
+            stream->deleteLater();
+            break;
+        case QMixerCommand::Play:
+            if (playVoice(stream)) {
+                // playing now overrides a scheduled start
+                m_voices[stream->m_voice].startAt = -1;
+            }
+            break;
+        case QMixerCommand::PlayAt:
+            if (stream->m_voice >= 0 || addVoice(stream)) {
+                m_voices[stream->m_voice].startAt = qMax<qint64>(0, command.value);
+            }
+            break;
+        case QMixerCommand::StopAt:
+            if (stream->m_voice >= 0) {
+                m_voices[stream->m_voice].stopAt = qMax<qint64>(0, command.value);
+            }
+            break;
+        case QMixerCommand::Stop:
+            if (stream->m_voice >= 0) {
+                removeVoice(stream->m_voice);
+            }
+            stream->execute(command);
+            break;
+        default:
+            stream->execute(command);
+            break;
+        }
+    }
+}
+
+int QMixerStreamPrivate::busIndex(const QString &name) const
+{
+    if (name.isEmpty()) {
+        return -1;
+    }
+    for (int i = 0; i < MaxBuses; ++i) {
+        if (m_busInfo.at(i).name == name) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void QMixerStreamPrivate::executeBusCommand(const QMixerCommand &command)
+{
+    QMixerBus &bus = m_buses[int(command.value)];
+    switch (command.type) {
+    case QMixerCommand::AddBus:
+        bus.live = true;
+        bus.parent = int(command.end);
+        bus.gain = bus.appliedGain = 1.0f;
+        bus.muted = false;
+        // the control side sized the buffer; the old one goes back to it
+        if (command.buffer) {
+            bus.buffer.swap(*command.buffer);
+            retire({QMixerCommand::AddBus, nullptr, 0, 0, 0, nullptr, nullptr, command.buffer});
+        }
+        break;
+    case QMixerCommand::RemoveBus:
+        // the control side routed the streams elsewhere already;
+        // the buses that fed this one now feed its parent
+        for (QMixerBus &child : m_buses) {
+            if (child.live && child.parent == int(command.value)) {
+                child.parent = bus.parent;
+            }
+        }
+        bus.live = false;
+        if (bus.insert) {
+            retire({QMixerCommand::RemoveBus, nullptr, 0, 0, 0, bus.insert, nullptr, nullptr});
+            bus.insert = nullptr;
+        }
+        break;
+    case QMixerCommand::SetBusGain:
+        bus.gain = command.gain;
+        break;
+    case QMixerCommand::SetBusMuted:
+        bus.muted = command.end != 0;
+        break;
+    case QMixerCommand::SetBusInsert:
+        if (bus.insert) {
+            retire({QMixerCommand::SetBusInsert, nullptr, 0, 0, 0, bus.insert, nullptr, nullptr});
+        }
+        bus.insert = command.insert;
+        break;
+    default:
+        break;
+    }
+    sortBuses();
+}
+
+// Orders the live buses so that every bus comes before the one it feeds,
+// which leaves the master bus last; works in place, without allocating
+void QMixerStreamPrivate::sortBuses()
+{
+    int depth[MaxBuses];
+    m_busCount = 0;
+    for (int i = 0; i < MaxBuses; ++i) {
+        if (!m_buses.at(i).live) {
+            continue;
+        }
+        depth[i] = 0;
+        for (int p = m_buses.at(i).parent; p >= 0; p = m_buses.at(p).parent) {
+            ++depth[i];
+        }
+        // insertion sort, deepest first
+        int j = m_busCount++;
+        for (; j > 0 && depth[m_busOrder[j - 1]] < depth[i]; --j) {
+            m_busOrder[j] = m_busOrder[j - 1];
+        }
+        m_busOrder[j] = i;
+    }
+    updateSubmix();
+}
+
+void QMixerStreamPrivate::updateSubmix()
+{
+    const QMixerBus &master = m_buses.at(0);
+    m_submix = m_busCount > 1 || master.insert || master.muted
+               || master.gain != 1.0f || master.appliedGain != 1.0f;
+}
+
+// m_gains = a linear ramp from one gain to another over count samples, the
+// same for all the channels of a frame
+const float *QMixerStreamPrivate::rampGain(float from, float to, qint64 count)
+{
+    const int channels = qMax(1, m_format.channelCount());
+    const qint64 frames = count / channels;
+    if (m_gains.size() < count) {
+        m_gains.resize(count);
+    }
+    float *gains = m_gains.data();
+    const float step = frames ? (to - from) / frames : 0.0f;
+    for (qint64 f = 0; f < frames; ++f) {
+        const float gain = from + step * (f + 1);
+        for (int c = 0; c < channels; ++c) {
+            gains[f * channels + c] = gain;
+        }
+    }
+    return gains;
+}
+
+// control side: builds a limiter for the current settings, which allocates,
+// and hands it to the mixing thread
+void QMixerStreamPrivate::updateLimiter()
+{
+    freeRetired();
+
+    QMixerLimiter *limiter = nullptr;
+    if (m_limiterEnabled) {
+        const qint64 rate = m_format.sampleRate();
+        limiter = new QMixerLimiter;
+        limiter->configure(m_format.channelCount(), int(qMax<qint64>(1, m_limiterLookahead * rate / 1000)),
+                           int(qMax<qint64>(1, m_limiterRelease * rate / 1000)));
+    }
+    if (!post({QMixerCommand::SetLimiter, nullptr, 0, 0, 0, nullptr, limiter, nullptr})) {
+        qWarning() << Q_FUNC_INFO << "command queue full, can't update the limiter";
+        delete limiter;
+    }
+}
+
+void QMixerStreamPrivate::freeRetired()
+{
+    QMixerCommand command;
+    while (m_retired.pop(command)) {
+        delete command.limiter;
+        delete command.insert;
+        delete command.buffer;
+    }
+}
+
+// mixing thread: hands what command points to back to the control side
+void QMixerStreamPrivate::retire(const QMixerCommand &command)
+{
+    if (!m_retired.push(command)) {
+        // can't happen: there are never more in flight than commands
+        delete command.limiter;
+        delete command.insert;
+        delete command.buffer;
+    }
+}
+
+// Returns false when the array is full; it never grows, see VoiceCapacity
+bool QMixerStreamPrivate::addVoice(QAbstractMixerStream *stream)
+{
+    if (m_voices.size() >= VoiceCapacity) {
+        return false;
+    }
+    stream->m_voice = m_voices.size();
+    // start at the current settings rather than ramping up from silence
+    m_voices.append({stream, stream->gain(), stream->pan(), m_playCount, false, -1, -1, false, 0.0f});
+    m_streamCount.store(m_voices.size());
+    return true;
+}
+
+// Streams are dropped from the mix when they stop or end; playing one again
+// brings it back. Returns false if the steal policy left no room for it, or
+// the voice array did.
+bool QMixerStreamPrivate::playVoice(QAbstractMixerStream *stream)
+{
+    const bool starting = stream->state() != QtMixer::Playing;
+    if (starting && !makeRoom(stream)) {
+        // everything playing outranks it
+        return false;
+    }
+    if (stream->m_voice < 0 && !addVoice(stream)) {
+        return false;
+    }
+    if (starting) {
+        QMixerVoice &voice = m_voices[stream->m_voice];
+        voice.started = ++m_playCount;
+        voice.fadingOut = false;
+    }
+    stream->play();
+    return true;
+}
+
+// Renders the next maxlen bytes of a voice into block, starting and stopping
+// it at the exact frame it was scheduled for. Returns the number of bytes
+// produced, including the silence before a start within the block.
+qint64 QMixerStreamPrivate::renderVoice(int index, char *block, qint64 maxlen)
+{
+    QAbstractMixerStream *stream = m_voices.at(index).stream;
+    const int frameBytes = m_format.bytesPerFrame();
+    const qint64 frames = frameBytes ? maxlen / frameBytes : 0;
+    const qint64 clock = m_frameClock.load();
+
+    qint64 offset = 0;
+    const qint64 startAt = m_voices.at(index).startAt;
+    if (startAt >= 0) {
+        if (startAt >= clock + frames) {
+            // not yet
+            return 0;
+        }
+        // a start that is already past happens right away
+        offset = qMax<qint64>(0, startAt - clock);
+        m_voices[index].startAt = -1;
+        if (!playVoice(stream)) {
+            // leaves the mix at the end of the block
+            m_voices[index].stopping = true;
+            return 0;
+        }
+    }
+
+    qint64 end = frames;
+    QMixerVoice &voice = m_voices[index];
+    if (voice.stopAt >= 0 && voice.stopAt < clock + frames) {
+        end = qMax(offset, voice.stopAt - clock);
+        voice.stopAt = -1;
+        voice.stopping = true;
+    }
+
+    const qint64 wanted = (end - offset) * frameBytes;
+    const qint64 n = stream->render(block + offset * frameBytes, wanted);
+    if (n < wanted && stream->state() == QtMixer::Playing && !stream->atEnd()) {
+        // starved rather than finished
+        m_shortReads.store(m_shortReads.load() + 1);
+    }
+    if (n <= 0) {
+        return 0;
+    }
+    memset(block, 0, offset * frameBytes);
+    return offset * frameBytes + n;
+}
+
+// whether a voice leaves the mix after the block just mixed
+bool QMixerStreamPrivate::isFinished(const QMixerVoice &voice) const
+{
+    return voice.fadingOut || voice.stopping || voice.stream->atEnd();
+}
+
+// Called before stream starts playing: when that would make one voice too
+// many, fades out those the steal policy picks. Returns false when all the
+// candidates outrank stream, which then shouldn't play.
+bool QMixerStreamPrivate::makeRoom(QAbstractMixerStream *stream)
+{
+    const int maxVoices = m_maxVoices.load();
+    if (maxVoices <= 0) {
+        return true;
+    }
+
+    for (;;) {
+        int playing = 0;
+        int victim = -1;
+        for (int i = 0; i < m_voices.size(); ++i) {
+            const QMixerVoice &voice = m_voices.at(i);
+            if (voice.fadingOut || voice.stream == stream
+                    || voice.stream->state() != QtMixer::Playing) {
+                continue;
+            }
+            ++playing;
+            if (voice.stream->priority() <= stream->priority()
+                    && (victim < 0 || stealsBefore(voice, m_voices.at(victim)))) {
+                victim = i;
+            }
+        }
+        if (playing < maxVoices) {
+            return true;
+        }
+        if (victim < 0) {
+            return false;
+        }
+        // a lowered limit may take more than one
+        m_voices[victim].fadingOut = true;
+    }
+}
+
+bool QMixerStreamPrivate::stealsBefore(const QMixerVoice &a, const QMixerVoice &b) const
+{
+    switch (m_stealPolicy.load()) {
+    case QtMixer::StealQuietest:
+        if (a.level != b.level) {
+            return a.level < b.level;
+        }
+        break;
+    case QtMixer::StealLowestPriority:
+        if (a.stream->priority() != b.stream->priority()) {
+            return a.stream->priority() < b.stream->priority();
+        }
+        break;
+    default:
+        break;
+    }
+    return a.started < b.started;
+}
+
+void QMixerStreamPrivate::removeVoice(int index)
+{
+    const int last = m_voices.size() - 1;
+    QAbstractMixerStream *stream = m_voices.at(index).stream;
+    stream->m_voice = -1;
+    stream->m_peakLevel.storeRelease(0);
+    stream->m_rmsLevel.storeRelease(0);
+    if (index != last) {
+        m_voices[index] = m_voices[last];
+        m_voices[index].stream->m_voice = index;
+    }
+    m_voices.removeLast();
+    m_streamCount.store(m_voices.size());
+}
+
+// Publishes the level of the block a voice rendered, measured while it is
+// still in the cache; no samples (not playing) is silence. The gain the voice
+// is mixed with now is applied to the result rather than to the samples.
+void QMixerStreamPrivate::meterVoice(int index, const char *block, qint64 count)
+{
+    QMixerVoice &voice = m_voices[index];
+    float peak = 0.0f;
+    float sumSquares = 0.0f;
+    if (count > 0) {
+        m_kernels.measure(block, count, &peak, &sumSquares);
+    }
+    const float gain = std::fabs(voice.gain);
+    voice.level = (count > 0 ? std::sqrt(sumSquares / count) : 0.0f) * gain;
+    voice.stream->m_peakLevel.storeRelease(qMixerFloatBits(peak * gain));
+    voice.stream->m_rmsLevel.storeRelease(qMixerFloatBits(voice.level));
+}
+
+// Publishes the level of the mix, from the float bus when there is one
+// (before it is clipped) or else from the output samples
+void QMixerStreamPrivate::meterOutput(const char *data, const float *bus, qint64 count)
+{
+    float peak = 0.0f;
+    float sumSquares = 0.0f;
+    if (bus) {
+        qMixerKernels().measureF32(bus, count, &peak, &sumSquares);
+    } else {
+        m_kernels.measure(data, count, &peak, &sumSquares);
+    }
+    m_peakLevel.storeRelease(qMixerFloatBits(peak));
+    m_rmsLevel.storeRelease(qMixerFloatBits(count > 0 ? std::sqrt(sumSquares / count) : 0.0f));
+}
+
+// Fills m_gains with the gains for the next count samples of a voice: a
+// linear ramp per channel from the settings of the last block to the current
+// ones, so that changes don't click. Returns false when all the samples get
+// the same gain, which is then stored in uniform instead.
+bool QMixerStreamPrivate::rampGains(QMixerVoice &voice, qint64 count, float *uniform)
+{
+    const float gain = voice.fadingOut ? 0.0f : voice.stream->gain();
+    const float pan = voice.stream->pan();
+    const int channels = m_format.channelCount();
+    const qint64 frames = channels > 0 ? count / channels : 0;
+    // panning needs different gains per channel even when nothing changes
+    const bool steady = gain == voice.gain && (channels < 2 || (pan == 0.0f && voice.pan == 0.0f));
+    if (!frames || steady) {
+        *uniform = gain;
+        voice.gain = gain;
+        voice.pan = pan;
+        return false;
+    }
+
+    if (m_gains.size() < count) {
+        m_gains.resize(count);
+    }
+    float *gains = m_gains.data();
+    for (int c = 0; c < channels; ++c) {
+        const float from = channelGain(voice.gain, voice.pan, c, channels);
+        const float to = channelGain(gain, pan, c, channels);
+        const float step = (to - from) / frames;
+        for (qint64 f = 0; f < frames; ++f) {
+            gains[f * channels + c] = from + step * (f + 1);
+        }
+    }
+    voice.gain = gain;
+    voice.pan = pan;
+    return true;
+}
+
+qint64 QMixerStreamPrivate::mix(char *data, qint64 maxlen)
+{
+    const qint64 start = m_clock.nsecsElapsed();
+    const qint64 n = mixBlock(data, maxlen);
+    recordBlock(m_clock.nsecsElapsed() - start, n);
+    return n;
+}
+
+// Accounts for a mix pass that took nanoseconds and produced bytes of audio
+void QMixerStreamPrivate::recordBlock(qint64 nanoseconds, qint64 bytes)
+{
+    const quint64 blocks = m_blocks.load() + 1;
+    m_blocks.store(blocks);
+    m_mixTime.store(m_mixTime.load() + nanoseconds);
+    if (blocks == 1 || nanoseconds < m_minBlockTime.load()) {
+        m_minBlockTime.store(nanoseconds);
+    }
+    if (nanoseconds > m_maxBlockTime.load()) {
+        m_maxBlockTime.store(nanoseconds);
+    }
+    const quint64 micro = quint64(qMax<qint64>(0, nanoseconds / 1000));
+    const int bucket = micro ? qMin<int>(HistogramBuckets - 1, 64 - qCountLeadingZeroBits(micro)) : 0;
+    m_histogram[bucket].store(m_histogram[bucket].load() + 1);
+
+    const int frameBytes = m_format.bytesPerFrame();
+    const qint64 frames = frameBytes ? bytes / frameBytes : 0;
+    if (frames > 0 && m_format.sampleRate() > 0) {
+        m_mixedFrames.store(m_mixedFrames.load() + frames);
+        const float load = float(double(nanoseconds) * m_format.sampleRate() / (double(frames) * 1e9));
+        if (load > qMixerBitsFloat(m_maxDspLoad.load())) {
+            m_maxDspLoad.store(qMixerFloatBits(load));
+        }
+    }
+
+    int active = 0;
+    for (const QMixerVoice &voice : qAsConst(m_voices)) {
+        if (voice.stream->state() == QtMixer::Playing) {
+            ++active;
+        }
+    }
+    m_activeVoices.store(active);
+}
+
+void QMixerStreamPrivate::resetStatistics()
+{
+    m_blocks.store(0);
+    m_mixTime.store(0);
+    m_minBlockTime.store(0);
+    m_maxBlockTime.store(0);
+    m_mixedFrames.store(0);
+    m_maxDspLoad.store(0);
+    for (int i = 0; i < HistogramBuckets; ++i) {
+        m_histogram[i].store(0);
+    }
+    m_shortReads.store(0);
+}
+
+qint64 QMixerStreamPrivate::mixBlock(char *data, qint64 maxlen)
+{
+    processCommands();
+
+    if (Q_UNLIKELY(m_voices.isEmpty())) {
+        if (!m_limiter || !m_limiter->hasTail() || !m_kernels.isValid()) {
+            m_peakLevel.storeRelease(0);
+            m_rmsLevel.storeRelease(0);
+            return 0;
+        }
+        // the end of the last sound is still in the lookahead: play it out
+        maxlen = drainLimiter(data, maxlen);
+    } else if (m_submix && m_kernels.isValid()) {
+        maxlen = mixBuses(data, maxlen);
+    } else if ((m_voices.size() == 1 && m_voices.at(0).startAt < 0 && m_voices.at(0).stopAt < 0 && !m_limiter)
+               || Q_UNLIKELY(!m_kernels.isValid())) {
+        // 1 stream only, fast codepath; this is also all we can do
+        // for an output format we don't know how to mix
+        QAbstractMixerStream *stream = m_voices.at(0).stream;
+        const qint64 wanted = maxlen;
+        maxlen = stream->readData(data, maxlen);
+        if (maxlen < wanted && stream->state() == QtMixer::Playing && !stream->atEnd()) {
+            m_shortReads.store(m_shortReads.load() + 1);
+        }
+        if (m_kernels.isValid()) {
+            const qint64 count = maxlen / m_kernels.bytesPerSample;
+            float gain;
+            const bool ramp = rampGains(m_voices[0], count, &gain);
+            meterVoice(0, data, count);
+            if (ramp) {
+                m_kernels.scaleWeighted(data, count, m_gains.constData());
+            } else if (gain != 1.0f) {
+                m_kernels.scale(data, count, gain);
+            }
+            meterOutput(data, nullptr, count);
+        }
+        if (isFinished(m_voices.at(0))) {
+            stream->stop();
+            removeVoice(0);
+        }
+    } else {
+        memset(data, 0, maxlen);
+        if (m_scratch.size() < maxlen) {
+            m_scratch.resize(maxlen);
+        }
+        char *block = m_scratch.data();
+        const QMixerFormatKernels &kernels = m_kernels;
+        const int sampleBytes = kernels.bytesPerSample;
+        const qint64 nSamples = maxlen / sampleBytes;
+        const bool floatBus = m_mixMode.load() == QtMixer::FloatMix || m_limiter;
+        float *bus = nullptr;
+        if (floatBus) {
+            if (m_bus.size() < nSamples) {
+                m_bus.resize(nSamples);
+            }
+            bus = m_bus.data();
+            memset(bus, 0, nSamples * sizeof(float));
+        }
+        qint64 nRead = 0;
+        for (int i = 0; i < m_voices.size();) {
+            QAbstractMixerStream *stream = m_voices.at(i).stream;
+            // pull a whole block from the stream and accumulate it in one go
+            const qint64 n = renderVoice(i, block, maxlen);
+            if (n > 0) {
+                const qint64 count = n / sampleBytes;
+                float gain;
+                const bool ramp = rampGains(m_voices[i], count, &gain);
+                // measured before the gain changes the block in place
+                meterVoice(i, block, count);
+                if (ramp) {
+                    // gain ramp or panning: a gain per sample
+                    if (floatBus) {
+                        kernels.accumulateWeighted(bus, block, count, m_gains.constData());
+                    } else {
+                        kernels.scaleWeighted(block, count, m_gains.constData());
+                        kernels.mix(data, block, count);
+                    }
+                } else if (floatBus) {
+                    kernels.accumulate(bus, block, count, gain);
+                } else {
+                    if (gain != 1.0f) {
+                        kernels.scale(block, count, gain);
+                    }
+                    kernels.mix(data, block, count);
+                }
+                nRead = qMax(nRead, n);
+            } else {
+                meterVoice(i, block, 0);
+            }
+
+            if (isFinished(m_voices.at(i))) {
+                stream->stop();
+                // the last voice moves into this slot, so look at it next
+                removeVoice(i);
+            } else {
+                ++i;
+            }
+        }
+        if (floatBus) {
+            if (m_limiter) {
+                m_limiter->process(bus, nSamples / qMax(1, m_format.channelCount()));
+            }
+            meterOutput(nullptr, bus, nSamples);
+            // the only place where the sum gets clipped
+            kernels.store(data, bus, nSamples);
+        } else {
+            meterOutput(data, nullptr, nSamples);
+        }
+        // streams that are still around but paused (or starved) contribute
+        // silence; the limiter delays the end of the mix by its lookahead
+        maxlen = m_voices.isEmpty() && !m_limiter ? nRead : maxlen;
+    }
+
+    const int frameBytes = m_format.bytesPerFrame();
+    if (frameBytes) {
+        m_frameClock.storeRelease(m_frameClock.load() + maxlen / frameBytes);
+    }
+
+    return maxlen;
+}
+
+// The mix through the submix buses: every voice is accumulated into the
+// float buffer of its bus, then each bus runs its insert and is accumulated
+// into its parent with its (ramped) gain, children first, and finally the
+// master bus is converted to the output format. Always goes through float
+// buffers, whatever the mix mode.
+qint64 QMixerStreamPrivate::mixBuses(char *data, qint64 maxlen)
+{
+    const QMixerFormatKernels &kernels = m_kernels;
+    const QMixerKernels &simd = qMixerKernels();
+    const int sampleBytes = kernels.bytesPerSample;
+    const qint64 nSamples = maxlen / sampleBytes;
+    const int channels = qMax(1, m_format.channelCount());
+
+    if (m_scratch.size() < maxlen) {
+        m_scratch.resize(maxlen);
+    }
+    char *block = m_scratch.data();
+    if (m_bus.size() < nSamples) {
+        m_bus.resize(nSamples);
+    }
+    if (nSamples > m_blockSamples.load()) {
+        m_blockSamples.store(int(qMin<qint64>(nSamples, INT_MAX)));
+    }
+    float *output = m_bus.data();
+    memset(output, 0, nSamples * sizeof(float));
+    for (int i = 0; i < m_busCount; ++i) {
+        QMixerBus &bus = m_buses[m_busOrder[i]];
+        if (bus.buffer.size() < nSamples) {
+            bus.buffer.resize(nSamples);
+        }
+        memset(bus.buffer.data(), 0, nSamples * sizeof(float));
+        bus.used = false;
+    }
+
+    qint64 nRead = 0;
+    for (int i = 0; i < m_voices.size();) {
+        QAbstractMixerStream *stream = m_voices.at(i).stream;
+        const qint64 n = renderVoice(i, block, maxlen);
+        if (n > 0) {
+            QMixerBus &bus = m_buses[stream->m_bus];
+            const qint64 count = n / sampleBytes;
+            float gain;
+            const bool ramp = rampGains(m_voices[i], count, &gain);
+            meterVoice(i, block, count);
+            if (ramp) {
+                kernels.accumulateWeighted(bus.buffer.data(), block, count, m_gains.constData());
+            } else {
+                kernels.accumulate(bus.buffer.data(), block, count, gain);
+            }
+            bus.used = true;
+            nRead = qMax(nRead, n);
+        } else {
+            meterVoice(i, block, 0);
+        }
+
+        if (isFinished(m_voices.at(i))) {
+            stream->stop();
+            removeVoice(i);
+        } else {
+            ++i;
+        }
+    }
+
+    for (int i = 0; i < m_busCount; ++i) {
+        QMixerBus &bus = m_buses[m_busOrder[i]];
+        const float target = bus.muted ? 0.0f : bus.gain;
+        // an insert may have a tail to play out after its input stopped
+        if (bus.used || bus.insert) {
+            float *buffer = bus.buffer.data();
+            if (bus.insert) {
+                bus.insert->process(buffer, nSamples / channels, channels);
+            }
+            float *parent = bus.parent >= 0 ? m_buses[bus.parent].buffer.data() : output;
+            if (target != bus.appliedGain) {
+                simd.accumulateF32Weighted(parent, buffer, nSamples, rampGain(bus.appliedGain, target, nSamples));
+            } else if (target != 0.0f) {
+                simd.accumulateF32(parent, buffer, nSamples, target);
+            }
+            if (bus.parent >= 0) {
+                m_buses[bus.parent].used = true;
+            }
+        }
+        bus.appliedGain = target;
+    }
+    if (m_limiter) {
+        m_limiter->process(output, nSamples / channels);
+    }
+    meterOutput(nullptr, output, nSamples);
+    kernels.store(data, output, nSamples);
+
+    // back to the flat mix once a ramp of the master bus is over, if that's all there was
+    updateSubmix();
+
+    return m_voices.isEmpty() && !m_limiter ? nRead : maxlen;
+}
+
+// Feeds the limiter silence once the last voice is gone, for what it still
+// delays to come out; returns the bytes produced
+qint64 QMixerStreamPrivate::drainLimiter(char *data, qint64 maxlen)
 {
+    const qint64 nSamples = maxlen / m_kernels.bytesPerSample;
+    if (m_bus.size() < nSamples) {
+        m_bus.resize(nSamples);
+    }
+    float *bus = m_bus.data();
+    memset(bus, 0, nSamples * sizeof(float));
+    m_limiter->process(bus, nSamples / qMax(1, m_format.channelCount()));
+    meterOutput(nullptr, bus, nSamples);
+    m_kernels.store(data, bus, nSamples);
+    return maxlen;
+}
 
+qint64 QMixerStreamPrivate::renderOffline(char *data, qint64 maxlen, bool untilDone)
+{
+    const int frameBytes = qMax(1, m_format.bytesPerFrame());
+    const qint64 block = OfflineBlockFrames * frameBytes;
+    qint64 done = 0;
+    while (done < maxlen) {
+        const qint64 len = qMin(block, maxlen - done);
+        processCommands();
+        if (!waitForDecoders(len)) {
+            return -1;
+        }
+        const qint64 n = qMax<qint64>(0, mix(data + done, len));
+        if (untilDone && !isPlaying()) {
+            done += n;
+            break;
+        }
+        if (n < len) {
+            // paused or stopped streams don't stop the clock
+            memset(data + done + n, 0, len - n);
+            m_frameClock.storeRelease(m_frameClock.load() + (len - n) / frameBytes);
+        }
+        done += len;
+    }
+    return done;
+}
+
+// Offline rendering doesn't have to keep pace with an output, so rather than
+// letting a voice come up short it waits for its decoder, which runs on a
+// QMixerDecodePool thread, until the next maxlen bytes are decoded or the
+// stream can't provide more. Gives up after DecoderTimeout milliseconds.
+bool QMixerStreamPrivate::waitForDecoders(qint64 maxlen)
+{
+    const int frameBytes = m_format.bytesPerFrame();
+    const qint64 end = m_frameClock.load() + (frameBytes ? maxlen / frameBytes : 0);
+    QElapsedTimer timer;
+    timer.start();
+    for (const QMixerVoice &voice : qAsConst(m_voices)) {
+        QAbstractMixerStream *stream = voice.stream;
+        const bool starting = voice.startAt >= 0 && voice.startAt < end;
+        if (stream->state() != QtMixer::Playing && !starting) {
+            continue;
+        }
+        while (!stream->hasPreroll(maxlen) && stream->state() != QtMixer::Unknown) {
+            stream->pollDecoder();
+            if (timer.hasExpired(DecoderTimeout)) {
+                qWarning() << Q_FUNC_INFO << "timed out waiting for" << stream;
+                return false;
+            }
+            QThread::usleep(100);
+        }
+    }
+    return true;
+}
+
+// whether any voice is playing or scheduled to start, or the limiter still
+// has the end of the mix to play out
+bool QMixerStreamPrivate::isPlaying() const
+{
+    if (m_limiter && m_limiter->hasTail()) {
+        return true;
+    }
+    for (const QMixerVoice &voice : m_voices) {
+        if (voice.startAt >= 0 || voice.stream->state() == QtMixer::Playing) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void QMixerStreamPrivate::startRenderThread()
+{
+    if (!m_renderThread) {
+        // readData() doesn't touch the ring until told to below
+        m_ring.resize(m_format.bytesForDuration(qint64(m_renderBufferDuration) * 1000));
+        // from now on readData() reads the ring; once one that may still be
+        // mixing is done, this thread is the only one to mix
+        m_useRing.fetchAndStoreOrdered(1);
+        waitForReaders();
+        m_renderThread = new QMixerRenderThread(this);
+        m_renderThread->start(QThread::TimeCriticalPriority);
+    }
+}
+
+void QMixerStreamPrivate::stopRenderThread()
+{
+    if (m_renderThread) {
+        // readData() plays what is left in the ring meanwhile, then
+        // takes over the mixing once no call may still be reading it
+        m_renderThread->stop();
+        delete m_renderThread;
+        m_renderThread = nullptr;
+        m_useRing.fetchAndStoreOrdered(0);
+        waitForReaders();
+        m_ring.resize(0);
+    }
+}
+
+// Waits for a readData() call that may have started before the mode switch
+// to return; the ones after it see the new mode. No more than one is ever
+// in progress, and not for long.
+void QMixerStreamPrivate::waitForReaders()
+{
+    while (m_readers.loadAcquire()) {
+        QThread::yieldCurrentThread();
+    }
 }
@@ -2,21 +2,319 @@
 #define QMIXERSTREAM_P_H
 
 #include <QList>
+#include <QString>
+#include <QByteArray>
+#include <QVector>
 #include <QAudioFormat>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+
+#include <cstring>
+
+#include "qtmixer.h"
+#include "qmixerformat_p.h"
+#include "qmixerringbuffer_p.h"
+#include "qmixercommandqueue_p.h"
+#include "qmixerlimiter_p.h"
 
 class QMixerStream;
 class QAbstractMixerStream;
+class QMixerRenderThread;
+class QMixerInsert;
+
+// floats shared through atomics are stored as their bits
+inline quint32 qMixerFloatBits(float value)
+{
+    quint32 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+inline float qMixerBitsFloat(quint32 bits)
+{
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+struct QMixerCommand
+{
+    enum Type {
+        Add,
+        Remove,
+        Play,
+        Pause,
+        Stop,
+        Seek,
+        SeekFrame,
+        SetLoops,
+        SetLoopRegion,
+        SetGain,
+        SetPan,
+        SetBus,
+        SetPriority,
+        PlayAt,
+        StopAt,
+        // submix bus graph changes, stream is null for these
+        AddBus,
+        RemoveBus,
+        SetBusGain,
+        SetBusMuted,
+        SetBusInsert,
+        // master limiter settings, stream is null
+        SetLimiter,
+        // zero the mixing thread's statistics, stream is null
+        ResetStatistics
+    };
+
+    Type type;
+    QAbstractMixerStream *stream;
+    // milliseconds for Seek, frame for SeekFrame, count for SetLoops,
+    // start frame for SetLoopRegion, bus index for SetBus and the bus commands,
+    // priority for SetPriority, mixer frame for PlayAt and StopAt,
+    qint64 value;
+    // value for SetGain, SetPan and SetBusGain
+    float gain;
+    // end frame for SetLoopRegion, parent bus for AddBus, flag for SetBusMuted
+    qint64 end;
+    // for SetBusInsert; the mixer owns it from then on
+    QMixerInsert *insert;
+    // for SetLimiter, configured already, null to turn it off
+    QMixerLimiter *limiter;
+    // for AddBus, the bus buffer, allocated by the control side
+    QVector<float> *buffer;
+    // The mixing thread hands back the limiter, inserts and buffers it
+    // replaces in commands of their own through m_retired, so that they
+    // aren't freed on the audio thread.
+};
+
+// One entry of the mixer's voice array
+struct QMixerVoice
+{
+    QAbstractMixerStream *stream;
+    // the gain and pan applied at the end of the last block, where the
+    // ramp to the stream's current settings starts
+    float gain;
+    float pan;
+    // when it last started playing, in the mixer's play count
+    quint64 started;
+    // stolen for another stream: ramped down to silence over the next
+    // block, then stopped
+    bool fadingOut;
+    // scheduled start and stop, in mixer frames; -1 for none
+    qint64 startAt;
+    qint64 stopAt;
+    // reached its stop frame in the block just mixed
+    bool stopping;
+    // the RMS level of the last block, after the gain
+    float level;
+};
+Q_DECLARE_TYPEINFO(QMixerVoice, Q_PRIMITIVE_TYPE);
+
+// A submix bus as seen by the mixing thread. Slot 0 is the master bus.
+struct QMixerBus
+{
+    bool live;
+    // the bus this one is mixed into, -1 for the master bus
+    int parent;
+    float gain;
+    bool muted;
+    // the gain applied at the end of the last block, where the ramp starts
+    float appliedGain;
+    QMixerInsert *insert;
+    // the bus's float buffer; only ever grows
+    QVector<float> buffer;
+    // whether anything was mixed into it during this block
+    bool used;
+};
+
+// The control side's copy of a bus slot; a free slot has no name
+struct QMixerBusInfo
+{
+    QString name;
+    int parent;
+    float gain;
+    bool muted;
+};
 
 class QMixerStreamPrivate
 {
     friend class QMixerStream;
+    friend class QMixerRenderThread;
+    friend class QMixerStreamHandle;
 
 public:
     QMixerStreamPrivate(const QAudioFormat &format);
+    ~QMixerStreamPrivate();
+
+    // mix the next maxlen bytes of all the streams into data;
+    // returns the number of bytes produced
+    qint64 mix(char *data, qint64 maxlen);
+
+    // queue a command for the mixing thread; never blocks, can be called from
+    // any thread. Returns false if the queue is full.
+    bool post(const QMixerCommand &command);
+    // carry out the queued commands; only called by the mixing thread
+    void processCommands();
+
+    // control side; they wait for a readData() call in progress to return
+    void startRenderThread();
+    void stopRenderThread();
+    void waitForReaders();
+
+    // offline rendering, see QMixerStream::renderOffline(): the calling thread
+    // becomes the mixing thread. Renders maxlen bytes, or when untilDone
+    // stops early once no stream plays any more; returns the bytes rendered,
+    // -1 when a decoder doesn't keep up at all.
+    qint64 renderOffline(char *data, qint64 maxlen, bool untilDone);
+
+    enum {
+        // bus slots, the master bus included; fixed so that the graph
+        // never allocates on the mixing thread
+        MaxBuses = 32,
+        // buckets of the block time histogram, see QMixerStatistics
+        HistogramBuckets = 20,
+        // the size of the voice array, reserved up front; the streams that
+        // play, are paused or are scheduled to start at once
+        VoiceCapacity = 256,
+        // the block size of offline rendering
+        OfflineBlockFrames = 1024,
+        // how long offline rendering waits for a decoder to provide the
+        // next block, in milliseconds
+        DecoderTimeout = 10000
+    };
+
+    // control side: the slot of a named bus, -1 if there is none
+    int busIndex(const QString &name) const;
 
 private:
+    // voice bookkeeping, mixing thread only
+    bool addVoice(QAbstractMixerStream *stream);
+    void removeVoice(int index);
+    bool rampGains(QMixerVoice &voice, qint64 count, float *uniform);
+    bool makeRoom(QAbstractMixerStream *stream);
+    bool playVoice(QAbstractMixerStream *stream);
+    qint64 renderVoice(int index, char *block, qint64 maxlen);
+    bool isFinished(const QMixerVoice &voice) const;
+    bool stealsBefore(const QMixerVoice &a, const QMixerVoice &b) const;
+
+    // bus graph, mixing thread only
+    qint64 mixBuses(char *data, qint64 maxlen);
+    qint64 drainLimiter(char *data, qint64 maxlen);
+    void retire(const QMixerCommand &command);
+    void executeBusCommand(const QMixerCommand &command);
+    void sortBuses();
+    void updateSubmix();
+    const float *rampGain(float from, float to, qint64 count);
+
+    // the mix proper; mix() times it for the statistics
+    qint64 mixBlock(char *data, qint64 maxlen);
+    void recordBlock(qint64 nanoseconds, qint64 bytes);
+    void resetStatistics();
+
+    // offline rendering
+    bool waitForDecoders(qint64 maxlen);
+    bool isPlaying() const;
+
+    // level meters, mixing thread only
+    void meterVoice(int index, const char *block, qint64 count);
+    void meterOutput(const char *data, const float *bus, qint64 count);
+    void updateLimiter();
+    // control side: deletes what the mixing thread is done with
+    void freeRetired();
+
+    // the streams opened and not yet closed; only touched by the control side
     QList<QAbstractMixerStream *> m_streams;
+    // the streams being mixed (playing, paused or scheduled), packed at the front of a contiguous array that
+    // belongs to the mixing thread; removal swaps the last voice into the gap.
+    // The other threads never see it: they publish changes as commands.
+    QVector<QMixerVoice> m_voices;
+    // m_voices.size(), for the other threads
+    QAtomicInt m_streamCount;
+    // the most streams playing at once, 0 for no limit, and who makes room
+    QAtomicInt m_maxVoices;
+    QAtomicInt m_stealPolicy;
+    // counts the streams started, to tell the oldest voice
+    quint64 m_playCount;
+    // the level of the last block mixed, float bits
+    QAtomicInteger<quint32> m_peakLevel;
+    QAtomicInteger<quint32> m_rmsLevel;
+    // the frames mixed so far, what PlayAt and StopAt refer to
+    QAtomicInteger<qint64> m_frameClock;
+    QMixerCommandQueue<QMixerCommand> m_commands;
     QAudioFormat m_format;
+    // the mix routines for m_format, looked up once
+    QMixerFormatKernels m_kernels;
+
+    // scratch block each stream renders into before it is mixed into the output;
+    // only ever grows so that the audio callback doesn't allocate in steady state
+    QByteArray m_scratch;
+
+    // set by the control side, read once per block
+    QAtomicInt m_mixMode;
+    // the float mix bus, one entry per output sample
+    QVector<float> m_bus;
+    // per sample gains of the voice being mixed, see rampGains()
+    QVector<float> m_gains;
+
+    // The submix buses, indexed by slot. The mixing thread visits the live ones
+    // in m_busOrder, children before their parents and the master bus last.
+    // m_submix is set while the buses make a difference to the output, which
+    // otherwise takes the flat path above.
+    QVector<QMixerBus> m_buses;
+    int m_busOrder[MaxBuses];
+    int m_busCount;
+    bool m_submix;
+    // control side
+    QVector<QMixerBusInfo> m_busInfo;
+
+    // The look-ahead limiter on the master output, in place of clipping the
+    // sum; it forces the float mix while enabled. The settings belong to the
+    // control side, which builds a limiter for them and passes it to the
+    // mixing thread; that owns m_limiter, null while disabled, and returns
+    // the ones it replaces through m_retired.
+    bool m_limiterEnabled;
+    int m_limiterLookahead;
+    int m_limiterRelease;
+    QMixerLimiter *m_limiter;
+    // objects the mixing thread replaced, see QMixerCommand
+    QMixerCommandQueue<QMixerCommand> m_retired;
+    // the largest block mixed through the buses so far, in samples, for
+    // the control side to size new bus buffers
+    QAtomicInt m_blockSamples;
+
+    // Statistics, see QMixerStatistics. The mixing thread is the only writer
+    // of these and updates them with plain atomic stores; m_callbacks is
+    // counted by the thread calling readData(), like m_underruns.
+    QAtomicInteger<quint64> m_callbacks;
+    QAtomicInteger<quint64> m_blocks;
+    QAtomicInteger<qint64> m_mixTime;
+    QAtomicInteger<qint64> m_minBlockTime;
+    QAtomicInteger<qint64> m_maxBlockTime;
+    QAtomicInteger<qint64> m_mixedFrames;
+    QAtomicInteger<quint32> m_maxDspLoad;
+    QAtomicInteger<quint64> m_histogram[HistogramBuckets];
+    QAtomicInt m_activeVoices;
+    QAtomicInteger<quint64> m_shortReads;
+    QElapsedTimer m_clock;
+
+    // when running, mixes into m_ring and readData() just copies from there
+    QMixerRenderThread *m_renderThread;
+    // what readData() does, switched by the control side; m_readers counts
+    // the readData() calls in progress, so that the switch can wait for them
+    QAtomicInt m_useRing;
+    QAtomicInt m_readers;
+    QMixerRingBuffer m_ring;
+    int m_renderBufferDuration;
+    QAtomicInt m_underruns;
+    bool m_underrunning;
+
+    // applies to streams opened in QtMixer::StreamingDecode mode
+    int m_streamingBufferDuration;
+    // the audio a stream needs decoded before it is ready to play,
+    // in milliseconds and in bytes of the mixer format
+    int m_prerollDuration;
+    QAtomicInteger<qint64> m_prerollBytes;
 };
 
 #endif // QMIXERSTREAM_P_H
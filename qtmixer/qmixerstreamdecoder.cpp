@@ -0,0 +1,212 @@
+#include <climits>
+
+#include <QDebug>
+
+#include "qmixerstreamdecoder_p.h"
+#include "qmixerdecodepool_p.h"
+
+QMixerStreamDecoder::QMixerStreamDecoder(const QString &fileName, const QAudioFormat &format,
+                                         int bufferDuration)
+    : m_file(fileName, this)
+    , m_decoder(this)
+    , m_pumpTimer(this)
+    , m_format(format)
+    , m_valid(false)
+    , m_pendingOffset(0)
+    , m_skip(0)
+    , m_passBytes(0)
+    , m_decodePasses(0)
+    , m_decoderFinished(false)
+    , m_loops(0)
+    , m_decoding(0)
+    , m_failed(0)
+    , m_length(0)
+    , m_lengthKnown(0)
+    , m_seekState(SeekIdle)
+    , m_seekTarget(0)
+{
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        qCritical() << "File or buffer initialisation failure in QMixerStreamDecoder";
+        return;
+    }
+    m_valid = true;
+
+    m_ring.resize(format.bytesForDuration(qint64(qMax(bufferDuration, 1)) * 1000));
+    // the decoder stalls while the ring is full, so check for room
+    // often enough that the ring never runs dry
+    m_pumpTimer.setInterval(qBound(5, bufferDuration / 8, 100));
+    connect(&m_pumpTimer, &QTimer::timeout, this, &QMixerStreamDecoder::pump);
+    m_decoding = 1;
+
+    // the file, the decoder and the timer are our children and move along
+    moveToThread(QMixerDecodePool::thread());
+    QMetaObject::invokeMethod(this, "start", Qt::QueuedConnection);
+}
+
+void QMixerStreamDecoder::start()
+{
+    m_decoder.setNotifyInterval(10);
+    m_decoder.setAudioFormat(m_format);
+    m_decoder.setSourceDevice(&m_file);
+    m_decoder.start();
+
+    if (!m_decoder.error()) {
+        connect(&m_decoder, &QAudioDecoder::bufferReady, this, &QMixerStreamDecoder::bufferReady);
+        connect(&m_decoder, static_cast<void(QAudioDecoder::*)(QAudioDecoder::Error)>(&QAudioDecoder::error),
+                this, &QMixerStreamDecoder::decoderError);
+        connect(&m_decoder, &QAudioDecoder::finished, this, &QMixerStreamDecoder::decoderFinished);
+        m_pumpTimer.start();
+    } else {
+        qCritical() << "Decoder error" << m_decoder.errorString() << "in QMixerStreamDecoder";
+        m_decoder.stop();
+        // nothing pumps, so seeks could never complete
+        m_failed.storeRelease(1);
+        m_decoding.storeRelease(0);
+        emit error(m_decoder.error(), m_decoder.errorString());
+    }
+}
+
+qint64 QMixerStreamDecoder::read(char *data, qint64 maxlen)
+{
+    flushIfSeeking();
+    if (m_seekState.loadAcquire() != SeekIdle) {
+        return 0;
+    }
+    return m_ring.read(data, int(qMin<qint64>(maxlen, INT_MAX)));
+}
+
+// Seeking means restarting the decoder, and the ring must be emptied in
+// between without either side ever waiting for the other: the mixing thread
+// requests the seek, the decoder's thread stops writing (SeekParked), the
+// mixing thread drops what is left in the ring (SeekDrained), and the
+// decoder's thread restarts decoding from the start of the file, throwing
+// away everything before the target (SeekIdle).
+void QMixerStreamDecoder::seek(qint64 target)
+{
+    // the decoder restarts, so there is more to come even if it was done
+    if (m_failed.loadAcquire()) {
+        return;
+    }
+    m_decoding.storeRelease(1);
+    m_seekTarget.storeRelease(target);
+    m_seekState.testAndSetOrdered(SeekIdle, SeekRequested);
+}
+
+void QMixerStreamDecoder::flushIfSeeking()
+{
+    if (m_seekState.loadAcquire() == SeekParked) {
+        m_ring.skip(m_ring.available());
+        m_seekState.storeRelease(SeekDrained);
+    }
+}
+
+bool QMixerStreamDecoder::atEnd() const
+{
+    // m_decoding is cleared after the last write to the ring
+    return !m_valid
+           || (m_seekState.loadAcquire() == SeekIdle
+               && !m_decoding.loadAcquire()
+               && !m_ring.available());
+}
+
+void QMixerStreamDecoder::restart(qint64 skip)
+{
+    m_decoder.stop();
+    m_file.seek(0);
+    m_decoder.setSourceDevice(&m_file);
+    m_pending = QAudioBuffer();
+    m_skip = skip;
+    m_passBytes = 0;
+    m_decoderFinished = false;
+    m_decoding.storeRelease(1);
+    m_decoder.start();
+}
+
+// Moves decoded audio into the ring for as long as there is room for it
+void QMixerStreamDecoder::pump()
+{
+    switch (m_seekState.loadAcquire()) {
+    case SeekRequested:
+        m_pending = QAudioBuffer();
+        m_seekState.storeRelease(SeekParked);
+        return;
+    case SeekParked:
+        return;
+    case SeekDrained:
+        m_decodePasses = 0;
+        restart(m_seekTarget.loadAcquire());
+        m_seekState.storeRelease(SeekIdle);
+        return;
+    default:
+        break;
+    }
+
+    for (;;) {
+        if (!m_pending.isValid()) {
+            if (!m_decoder.bufferAvailable()) {
+                break;
+            }
+            m_pending = m_decoder.read();
+            m_pendingOffset = 0;
+            m_passBytes += m_pending.byteCount();
+            if (!m_lengthKnown.load() && m_passBytes > m_length.load()) {
+                m_length.storeRelease(m_passBytes);
+            }
+        }
+
+        const int size = m_pending.byteCount();
+        if (m_skip > 0) {
+            const int skipped = int(qMin<qint64>(m_skip, size - m_pendingOffset));
+            m_skip -= skipped;
+            m_pendingOffset += skipped;
+        }
+        m_pendingOffset += m_ring.write(m_pending.constData<char>() + m_pendingOffset,
+                                        size - m_pendingOffset);
+        if (m_pendingOffset < size) {
+            // the ring is full. Whatever we don't read stays queued in the
+            // decoder, which stops decoding once its queue is full.
+            return;
+        }
+        m_pending = QAudioBuffer();
+    }
+
+    if (m_decoderFinished) {
+        // the whole pass went into the ring
+        m_decoderFinished = false;
+        if (!m_lengthKnown.load()) {
+            m_length.storeRelease(m_passBytes);
+            m_lengthKnown.storeRelease(1);
+            emit finished();
+        }
+        ++m_decodePasses;
+        const int loops = m_loops.load();
+        if (loops < 0 || m_decodePasses < loops) {
+            restart(0);
+        } else {
+            m_decoding.storeRelease(0);
+        }
+    }
+}
+
+void QMixerStreamDecoder::bufferReady()
+{
+    pump();
+    emit dataAdded();
+}
+
+void QMixerStreamDecoder::decoderError(QAudioDecoder::Error error)
+{
+    qDebug() << Q_FUNC_INFO << m_decoder.errorString();
+    // there won't be any more audio; let the stream end where decoding stopped
+    m_decoding.storeRelease(0);
+    emit this->error(error, m_decoder.errorString());
+}
+
+void QMixerStreamDecoder::decoderFinished()
+{
+    // there may still be decoded buffers waiting for room in the ring
+    m_decoderFinished = true;
+    pump();
+}
+
+#include "moc_qmixerstreamdecoder_p.cpp"
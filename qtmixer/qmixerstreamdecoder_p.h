@@ -0,0 +1,102 @@
+#ifndef QMIXERSTREAMDECODER_P_H
+#define QMIXERSTREAMDECODER_P_H
+
+#include <QObject>
+#include <QFile>
+#include <QTimer>
+#include <QAudioBuffer>
+#include <QAudioDecoder>
+#include <QAudioFormat>
+#include <QAtomicInt>
+#include <QAtomicInteger>
+
+#include "qmixerringbuffer_p.h"
+
+// The decoding half of a stream in QtMixer::StreamingDecode mode. It runs on a
+// QMixerDecodePool thread and keeps only a ring of decoded audio ahead of the
+// play cursor: when the ring is full it stops reading from the decoder, which
+// stops decoding once its own queue is full, and a timer picks up again as
+// soon as there is room. The mixing thread drains the ring through the
+// consumer side; neither side ever waits for the other.
+class QMixerStreamDecoder : public QObject
+{
+    Q_OBJECT
+
+public:
+    // bufferDuration is the amount of audio to keep ready, in milliseconds
+    QMixerStreamDecoder(const QString &fileName, const QAudioFormat &format, int bufferDuration);
+
+    // false if the file couldn't be opened
+    bool isValid() const { return m_valid; }
+
+    // consumer side, mixing thread only
+    // returns 0 while a seek is in progress
+    qint64 read(char *data, qint64 maxlen);
+    void seek(qint64 target);
+    // needs calling even while nothing is read, for seeks to complete
+    void flushIfSeeking();
+
+    // any thread
+    bool atEnd() const;
+    bool isSeeking() const { return m_seekState.loadAcquire() != SeekIdle; }
+    // the decoded length in bytes; final once isLengthKnown()
+    qint64 length() const { return m_length.loadAcquire(); }
+    bool isLengthKnown() const { return m_lengthKnown.loadAcquire(); }
+    // false once everything the ring will get was written to it
+    bool isDecoding() const { return m_decoding.loadAcquire(); }
+    // decoded bytes waiting in the ring, and how many it can hold
+    int available() const { return m_ring.available(); }
+    int capacity() const { return m_ring.capacity(); }
+    void setLoops(int loops) { m_loops.storeRelease(loops); }
+
+Q_SIGNALS:
+    void dataAdded();
+    void finished();
+    void error(int error, const QString &errorString);
+
+private:
+    enum SeekState {
+        // see seek()
+        SeekIdle,
+        SeekRequested,
+        SeekParked,
+        SeekDrained
+    };
+
+    Q_INVOKABLE void start();
+    void pump();
+    void restart(qint64 skip);
+    void bufferReady();
+    void decoderError(QAudioDecoder::Error error);
+    void decoderFinished();
+
+    QFile m_file;
+    QAudioDecoder m_decoder;
+    QTimer m_pumpTimer;
+    QAudioFormat m_format;
+    bool m_valid;
+
+    QMixerRingBuffer m_ring;
+    // decoder side: the decoded buffer that didn't fit in the ring yet
+    QAudioBuffer m_pending;
+    int m_pendingOffset;
+    // bytes still to be thrown away after a restart, to reach a seek target
+    qint64 m_skip;
+    // bytes decoded during the current pass over the file
+    qint64 m_passBytes;
+    int m_decodePasses;
+    bool m_decoderFinished;
+
+    QAtomicInt m_loops;
+    // set while the decoder has, or will have, more audio for the ring
+    QAtomicInt m_decoding;
+    // set if the decoder didn't even start
+    QAtomicInt m_failed;
+    QAtomicInteger<qint64> m_length;
+    // set once a whole pass was decoded, so that m_length is final
+    QAtomicInt m_lengthKnown;
+    QAtomicInt m_seekState;
+    QAtomicInteger<qint64> m_seekTarget;
+};
+
+#endif // QMIXERSTREAMDECODER_P_H
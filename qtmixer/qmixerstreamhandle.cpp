@@ -1,5 +1,6 @@
 #include "qmixerstreamhandle.h"
 #include "qabstractmixerstream.h"
+#include "qmixerstream_p.h"
 
 QMixerStreamHandle::QMixerStreamHandle()
     : m_stream(nullptr)
@@ -16,21 +17,35 @@ QMixerStreamHandle::QMixerStreamHandle(QAbstractMixerStream *stream)
 void QMixerStreamHandle::play()
 {
     if (m_stream) {
-        m_stream->play();
+        m_stream->post({QMixerCommand::Play, m_stream, 0, 0, 0, nullptr, nullptr, nullptr});
     }
 }
 
 void QMixerStreamHandle::pause()
 {
     if (m_stream) {
-        m_stream->pause();
+        m_stream->post({QMixerCommand::Pause, m_stream, 0, 0, 0, nullptr, nullptr, nullptr});
     }
 }
 
 void QMixerStreamHandle::stop()
 {
     if (m_stream) {
-        m_stream->stop();
+        m_stream->post({QMixerCommand::Stop, m_stream, 0, 0, 0, nullptr, nullptr, nullptr});
+    }
+}
+
+void QMixerStreamHandle::playAt(qint64 frame)
+{
+    if (m_stream) {
+        m_stream->post({QMixerCommand::PlayAt, m_stream, frame, 0, 0, nullptr, nullptr, nullptr});
+    }
+}
+
+void QMixerStreamHandle::stopAt(qint64 frame)
+{
+    if (m_stream) {
+        m_stream->post({QMixerCommand::StopAt, m_stream, frame, 0, 0, nullptr, nullptr, nullptr});
     }
 }
 
@@ -55,11 +70,27 @@ int QMixerStreamHandle::loops() const
 void QMixerStreamHandle::setLoops(int loops)
 {
     if (m_stream) {
-        m_stream->setLoops(loops);
+        m_stream->post({QMixerCommand::SetLoops, m_stream, loops, 0, 0, nullptr, nullptr, nullptr});
+    }
+}
+
+qint64 QMixerStreamHandle::loopStart() const
+{
+    return m_stream ? m_stream->loopStart() : 0;
+}
+
+qint64 QMixerStreamHandle::loopEnd() const
+{
+    return m_stream ? m_stream->loopEnd() : -1;
+}
+
+void QMixerStreamHandle::setLoopRegion(qint64 start, qint64 end)
+{
+    if (m_stream) {
+        m_stream->post({QMixerCommand::SetLoopRegion, m_stream, start, 0, end, nullptr, nullptr, nullptr});
     }
 }
 
-// FIXME: always returns 0?!
 int QMixerStreamHandle::position() const
 {
     if (m_stream) {
@@ -72,15 +103,112 @@ int QMixerStreamHandle::position() const
 void QMixerStreamHandle::setPosition(int position)
 {
     if (m_stream) {
-        m_stream->setPosition(position);
+        m_stream->post({QMixerCommand::Seek, m_stream, position, 0, 0, nullptr, nullptr, nullptr});
+    }
+}
+
+qint64 QMixerStreamHandle::framePosition() const
+{
+    if (m_stream) {
+        return m_stream->framePosition();
+    } else {
+        return -1;
+    }
+}
+
+void QMixerStreamHandle::setFramePosition(qint64 frame)
+{
+    if (m_stream) {
+        m_stream->post({QMixerCommand::SeekFrame, m_stream, frame, 0, 0, nullptr, nullptr, nullptr});
+    }
+}
+
+qint64 QMixerStreamHandle::frameLength() const
+{
+    if (m_stream) {
+        return m_stream->frameLength();
+    } else {
+        return -1;
+    }
+}
+
+float QMixerStreamHandle::peakLevel() const
+{
+    return m_stream ? m_stream->peakLevel() : 0.0f;
+}
+
+float QMixerStreamHandle::rmsLevel() const
+{
+    return m_stream ? m_stream->rmsLevel() : 0.0f;
+}
+
+float QMixerStreamHandle::gain() const
+{
+    return m_stream ? m_stream->gain() : 0.0f;
+}
+
+void QMixerStreamHandle::setGain(float gain)
+{
+    if (m_stream) {
+        m_stream->post({QMixerCommand::SetGain, m_stream, 0, gain, 0, nullptr, nullptr, nullptr});
+    }
+}
+
+float QMixerStreamHandle::pan() const
+{
+    return m_stream ? m_stream->pan() : 0.0f;
+}
+
+void QMixerStreamHandle::setPan(float pan)
+{
+    if (m_stream) {
+        m_stream->post({QMixerCommand::SetPan, m_stream, 0, pan, 0, nullptr, nullptr, nullptr});
     }
 }
 
+int QMixerStreamHandle::priority() const
+{
+    return m_stream ? m_stream->priority() : 0;
+}
+
+void QMixerStreamHandle::setPriority(int priority)
+{
+    if (m_stream) {
+        m_stream->post({QMixerCommand::SetPriority, m_stream, priority, 0, 0, nullptr, nullptr, nullptr});
+    }
+}
+
+QString QMixerStreamHandle::bus() const
+{
+    if (m_stream && m_stream->m_mixer) {
+        return m_stream->m_mixer->m_busInfo.at(m_stream->m_routedBus).name;
+    } else {
+        return QString();
+    }
+}
+
+bool QMixerStreamHandle::setBus(const QString &name)
+{
+    if (m_stream && m_stream->m_mixer) {
+        const int bus = m_stream->m_mixer->busIndex(name);
+        if (bus >= 0 && m_stream->post({QMixerCommand::SetBus, m_stream, bus, 0, 0, nullptr, nullptr, nullptr})) {
+            m_stream->m_routedBus = bus;
+            return true;
+        }
+    }
+    return false;
+}
+
 bool QMixerStreamHandle::atEnd()
 {
     return m_stream ? m_stream->done() : false;
 }
 
+bool QMixerStreamHandle::isReady() const
+{
+    return m_stream ? m_stream->isReady() : false;
+}
+
 int QMixerStreamHandle::length() const
 {
     if (m_stream) {
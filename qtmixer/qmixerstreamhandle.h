@@ -1,16 +1,22 @@
 #ifndef QMIXERSTREAMHANDLE_H
 #define QMIXERSTREAMHANDLE_H
 
+#include <QMetaType>
+#include <QString>
+
 #include "qtmixer.h"
 
 class QAbstractMixerStream;
 class QAudioDecoderStream;
+class QPcmFileStream;
 class QMixerStream;
 
 class QTMIXER_EXPORT QMixerStreamHandle
 {
     friend class QMixerStream;
+    friend class QAbstractMixerStream;
     friend class QAudioDecoderStream;
+    friend class QPcmFileStream;
 
 public:
     QMixerStreamHandle();
@@ -19,14 +25,61 @@ public:
     void pause();
     void stop();
 
+    // Start or stop at an exact frame of the mixer's frameClock(), wherever it
+    // falls within a block; a frame that is already past takes effect right
+    // away. stop() cancels both.
+    void playAt(qint64 frame);
+    void stopAt(qint64 frame);
+
     QtMixer::State state() const;
 
     int loops() const;
     void setLoops(int loops);
 
+    // the frames [start, end) that are repeated while looping, end -1 meaning
+    // the end of the stream; see QAbstractMixerStream::loopStart(). Streams
+    // opened in QtMixer::StreamingDecode mode always loop the whole file.
+    qint64 loopStart() const;
+    qint64 loopEnd() const;
+    void setLoopRegion(qint64 start, qint64 end = -1);
+
+    // in milliseconds, rounded down; see framePosition() for exact positions
     int position() const;
     void setPosition(int position);
+
+    // the position and length in frames (samples per channel) at the mixer's
+    // sample rate; seeking to a frame lands exactly on it
+    qint64 framePosition() const;
+    void setFramePosition(qint64 frame);
+    qint64 frameLength() const;
+
+    // Linear gain and stereo position (-1 left, 0 centre, 1 right) applied
+    // when mixing, 1.0 and 0 by default. Changes are ramped over one mix block
+    // so that they don't click.
+    float gain() const;
+    void setGain(float gain);
+    float pan() const;
+    void setPan(float pan);
+
+    // the peak and RMS level of the stream in the last block mixed, 1 being
+    // full scale; see QAbstractMixerStream::peakLevel()
+    float peakLevel() const;
+    float rmsLevel() const;
+
+    // streams with a higher priority are kept playing over those with a lower
+    // one when the mixer runs out of voices, see QtMixer::StealPolicy; 0 by default
+    int priority() const;
+    void setPriority(int priority);
+
+    // the submix bus the stream is mixed into, see QMixerStream::addBus();
+    // "master" by default. Returns false for an unknown name, or when the
+    // mixer is too busy to take the change.
+    QString bus() const;
+    bool setBus(const QString &name);
+
     bool atEnd();
+    // see QMixerStream::streamReady()
+    bool isReady() const;
 
     int length() const;
     bool isValid() const;
@@ -39,4 +92,6 @@ private:
     QAbstractMixerStream *m_stream;
 };
 
+Q_DECLARE_METATYPE(QMixerStreamHandle)
+
 #endif // QMIXERSTREAMHANDLE_H
@@ -0,0 +1,318 @@
+#include <cstring>
+
+#include <QDebug>
+#include <QFileInfo>
+#include <QtEndian>
+
+#include "qpcmfilestream.h"
+
+namespace {
+
+enum {
+    WavePcm = 0x0001,
+    WaveFloat = 0x0003,
+    WaveExtensible = 0xfffe
+};
+
+} // namespace
+
+QPcmFileStream::QPcmFileStream(const QString &fileName, const QAudioFormat &format)
+    : m_file(fileName)
+    , m_format(format)
+    , m_data(nullptr)
+    , m_frames(0)
+    , m_fileFrameBytes(0)
+    , m_frameBytes(format.bytesPerFrame())
+    , m_convert(false)
+    , m_source(qMixerFormatKernels(QAudioFormat()))
+    , m_target(qMixerFormatKernels(format))
+    , m_state(QtMixer::Unknown)
+    , m_loops(0)
+    , m_remainingLoops(0)
+    , m_frame(0)
+{
+    const QString suffix = QFileInfo(fileName).suffix().toLower();
+    const bool raw = suffix == QLatin1String("raw") || suffix == QLatin1String("pcm");
+    if ((!raw && suffix != QLatin1String("wav")) || !m_file.open(QIODevice::ReadOnly) || !m_frameBytes) {
+        return;
+    }
+
+    const qint64 size = m_file.size();
+    const uchar *file = size > 0 ? m_file.map(0, size) : nullptr;
+    if (!file) {
+        return;
+    }
+
+    if (raw) {
+        m_fileFormat = format;
+        m_data = reinterpret_cast<const char *>(file);
+        m_frames = size / m_frameBytes;
+    } else if (!parseWav(file, size)) {
+        qWarning() << "Can't play" << fileName << "without decoding it";
+        return;
+    }
+    m_fileFrameBytes = m_fileFormat.bytesPerFrame();
+
+    if (m_fileFormat != format) {
+        // the sample rate is the one thing we can't convert
+        const bool channelsOk = m_fileFormat.channelCount() == format.channelCount()
+                                || m_fileFormat.channelCount() == 1;
+        m_source = qMixerFormatKernels(m_fileFormat);
+        if (m_fileFormat.sampleRate() != format.sampleRate() || !channelsOk
+                || !m_source.isValid() || !m_target.isValid()) {
+            qWarning() << "Can't convert" << fileName << "from" << m_fileFormat << "to" << format;
+            return;
+        }
+        m_convert = true;
+        m_bus.resize(BusFrames * format.channelCount());
+    }
+
+    setOpenMode(QIODevice::ReadOnly);
+    m_state = QtMixer::Stopped;
+}
+
+bool QPcmFileStream::parseWav(const uchar *file, qint64 size)
+{
+    if (size < 12 || memcmp(file + 8, "WAVE", 4)) {
+        return false;
+    }
+    // RIFX is the big endian variant
+    const bool bigEndian = !memcmp(file, "RIFX", 4);
+    if (!bigEndian && memcmp(file, "RIFF", 4)) {
+        return false;
+    }
+    auto read16 = [bigEndian](const uchar *p) {
+        return bigEndian ? qFromBigEndian<quint16>(p) : qFromLittleEndian<quint16>(p);
+    };
+    auto read32 = [bigEndian](const uchar *p) {
+        return bigEndian ? qFromBigEndian<quint32>(p) : qFromLittleEndian<quint32>(p);
+    };
+
+    bool haveFormat = false;
+    qint64 pos = 12;
+    while (pos + 8 <= size) {
+        const uchar *chunk = file + pos;
+        // clamp, some writers leave the size of the last chunk at its maximum
+        const qint64 chunkSize = qMin<qint64>(read32(chunk + 4), size - pos - 8);
+
+        if (!memcmp(chunk, "fmt ", 4) && chunkSize >= 16) {
+            quint16 tag = read16(chunk + 8);
+            const int channels = read16(chunk + 10);
+            const int sampleRate = int(read32(chunk + 12));
+            const int blockAlign = read16(chunk + 20);
+            const int bits = read16(chunk + 22);
+            if (tag == WaveExtensible && chunkSize >= 40) {
+                // the sub format GUID starts with the actual tag
+                tag = read16(chunk + 32);
+            }
+            if ((tag != WavePcm && tag != WaveFloat) || !channels || bits % 8
+                    || blockAlign != channels * bits / 8) {
+                return false;
+            }
+            m_fileFormat.setCodec(QStringLiteral("audio/pcm"));
+            m_fileFormat.setSampleRate(sampleRate);
+            m_fileFormat.setChannelCount(channels);
+            m_fileFormat.setSampleSize(bits);
+            m_fileFormat.setSampleType(tag == WaveFloat ? QAudioFormat::Float
+                                       : bits == 8 ? QAudioFormat::UnSignedInt
+                                       : QAudioFormat::SignedInt);
+            m_fileFormat.setByteOrder(bigEndian ? QAudioFormat::BigEndian : QAudioFormat::LittleEndian);
+            haveFormat = true;
+        } else if (!memcmp(chunk, "data", 4) && haveFormat) {
+            m_data = reinterpret_cast<const char *>(chunk + 8);
+            m_frames = chunkSize / m_fileFormat.bytesPerFrame();
+            return true;
+        }
+        // chunks are padded to an even size
+        pos += 8 + chunkSize + (chunkSize & 1);
+    }
+
+    return false;
+}
+
+bool QPcmFileStream::isValid() const
+{
+    return m_data != nullptr && m_state != QtMixer::Unknown;
+}
+
+QAudioFormat QPcmFileStream::fileFormat() const
+{
+    return m_fileFormat;
+}
+
+qint64 QPcmFileStream::readData(char *data, qint64 maxlen)
+{
+    if (m_state != QtMixer::Playing) {
+        memset(data, 0, maxlen);
+        return maxlen;
+    }
+
+    const qint64 n = render(data, maxlen);
+    memset(data + n, 0, maxlen - n);
+
+    return n;
+}
+
+qint64 QPcmFileStream::writeData(const char *data, qint64 len)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(len);
+
+    return 0;
+}
+
+qint64 QPcmFileStream::render(char *data, qint64 maxlen)
+{
+    if (m_state != QtMixer::Playing) {
+        return 0;
+    }
+
+    const qint64 maxFrames = maxlen / m_frameBytes;
+    qint64 frame = m_frame.load();
+    qint64 frames = 0;
+    while (frames < maxFrames) {
+        const qint64 wrap = loopWrapFrame(frame, m_frames, m_loops < 0 || m_remainingLoops > 1);
+        const qint64 n = qMax<qint64>(qMin(maxFrames - frames, (wrap >= 0 ? wrap : m_frames) - frame), 0);
+        const char *src = m_data + frame * m_fileFrameBytes;
+        char *dst = data + frames * m_frameBytes;
+        if (m_convert) {
+            convert(dst, src, n);
+        } else {
+            // the only copy, straight from the page cache into the mix
+            memcpy(dst, src, n * m_frameBytes);
+        }
+        frame += n;
+        frames += n;
+
+        if (frame == wrap) {
+            // carry on from the loop start within the same block
+            frame = loopStart();
+            if (m_loops > 0) {
+                --m_remainingLoops;
+            }
+        } else if (!n) {
+            break;
+        }
+    }
+    m_frame.storeRelease(frame);
+
+    return frames * m_frameBytes;
+}
+
+void QPcmFileStream::convert(char *data, const char *src, qint64 frames)
+{
+    const int fileChannels = m_fileFormat.channelCount();
+    const int channels = m_format.channelCount();
+    float *bus = m_bus.data();
+
+    while (frames > 0) {
+        const qint64 n = qMin<qint64>(frames, BusFrames);
+        memset(bus, 0, n * fileChannels * sizeof(float));
+        m_source.accumulate(bus, src, n * fileChannels, 1.0f);
+        if (fileChannels != channels) {
+            // mono: spread every sample over all channels, from the back so
+            // that nothing is overwritten before it is read
+            for (qint64 i = n - 1; i >= 0; --i) {
+                const float sample = bus[i];
+                for (int c = 0; c < channels; ++c) {
+                    bus[i * channels + c] = sample;
+                }
+            }
+        }
+        m_target.store(data, bus, n * channels);
+
+        src += n * m_fileFrameBytes;
+        data += n * m_frameBytes;
+        frames -= n;
+    }
+}
+
+bool QPcmFileStream::atEnd() const
+{
+    return m_state == QtMixer::Unknown || m_frame.loadAcquire() >= m_frames;
+}
+
+bool QPcmFileStream::done() const
+{
+    // nothing to decode
+    return m_state != QtMixer::Unknown;
+}
+
+void QPcmFileStream::play()
+{
+    if (m_state != QtMixer::Unknown) {
+        m_state = QtMixer::Playing;
+
+        emit stateChanged(this, state());
+    }
+}
+
+void QPcmFileStream::pause()
+{
+    if (m_state == QtMixer::Playing) {
+        m_state = QtMixer::Paused;
+
+        emit stateChanged(this, state());
+    }
+}
+
+void QPcmFileStream::stop()
+{
+    if (m_state != QtMixer::Unknown && m_state != QtMixer::Stopped) {
+        m_state = QtMixer::Stopped;
+        m_remainingLoops = m_loops;
+        m_frame.storeRelease(0);
+
+        emit stateChanged(this, state());
+    }
+}
+
+QtMixer::State QPcmFileStream::state() const
+{
+    return QtMixer::State(m_state.loadAcquire());
+}
+
+int QPcmFileStream::loops() const
+{
+    return m_loops;
+}
+
+void QPcmFileStream::setLoops(int loops)
+{
+    m_loops = loops;
+    m_remainingLoops = loops;
+}
+
+int QPcmFileStream::position() const
+{
+    const qint64 frame = framePosition();
+    return frame >= 0 ? int(frame * 1000 / m_format.sampleRate()) : -1;
+}
+
+void QPcmFileStream::setPosition(int position)
+{
+    setFramePosition(qint64(position) * m_format.sampleRate() / 1000);
+}
+
+int QPcmFileStream::length()
+{
+    const qint64 frames = frameLength();
+    return frames >= 0 ? int(frames * 1000 / m_format.sampleRate()) : -1;
+}
+
+qint64 QPcmFileStream::framePosition() const
+{
+    return m_state != QtMixer::Unknown ? m_frame.loadAcquire() : -1;
+}
+
+void QPcmFileStream::setFramePosition(qint64 frame)
+{
+    if (m_state != QtMixer::Unknown) {
+        m_frame.storeRelease(qBound<qint64>(0, frame, m_frames));
+    }
+}
+
+qint64 QPcmFileStream::frameLength()
+{
+    return m_state != QtMixer::Unknown ? m_frames : -1;
+}
@@ -0,0 +1,83 @@
+#ifndef QPCMFILESTREAM_H
+#define QPCMFILESTREAM_H
+
+#include <QAudioFormat>
+#include <QFile>
+#include <QVector>
+
+#include "qabstractmixerstream.h"
+#include "qmixerformat_p.h"
+
+// Plays uncompressed WAV files, and raw PCM files (.raw, .pcm) in the mixer
+// format, straight from a memory mapping of the file, without QAudioDecoder.
+// Files in another sample format, or mono files for a multi-channel mixer,
+// are converted on the fly; files at another sample rate are not supported
+// and leave the stream invalid.
+class QTMIXER_EXPORT QPcmFileStream : public QAbstractMixerStream
+{
+public:
+    QPcmFileStream(const QString &fileName, const QAudioFormat &format);
+
+    // false if the file isn't one we can play
+    bool isValid() const;
+    QAudioFormat fileFormat() const;
+
+    bool atEnd() const override;
+    bool done() const override;
+
+    void play() override;
+    void pause() override;
+    void stop() override;
+
+    QtMixer::State state() const override;
+
+    int loops() const override;
+    void setLoops(int loops) override;
+
+    int position() const override;
+    void setPosition(int position) override;
+
+    int length() override;
+
+    qint64 framePosition() const override;
+    void setFramePosition(qint64 frame) override;
+    qint64 frameLength() override;
+
+    qint64 render(char *data, qint64 maxlen) override;
+
+protected:
+    qint64 readData(char *data, qint64 maxlen) override;
+    qint64 writeData(const char *data, qint64 len) override;
+
+private:
+    enum {
+        // frames converted per pass through m_bus
+        BusFrames = 1024
+    };
+
+    bool parseWav(const uchar *file, qint64 size);
+    void convert(char *data, const char *src, qint64 frames);
+
+    QFile m_file;
+    QAudioFormat m_format;
+    QAudioFormat m_fileFormat;
+    // the sample data inside the mapping
+    const char *m_data;
+    qint64 m_frames;
+    int m_fileFrameBytes;
+    int m_frameBytes;
+
+    bool m_convert;
+    QMixerFormatKernels m_source;
+    QMixerFormatKernels m_target;
+    // allocated up front, so that converting never allocates
+    QVector<float> m_bus;
+
+    QAtomicInt m_state;
+    QAtomicInt m_loops;
+    int m_remainingLoops;
+    // the play position, only ever changed by the mixing thread
+    QAtomicInteger<qint64> m_frame;
+};
+
+#endif // QPCMFILESTREAM_H
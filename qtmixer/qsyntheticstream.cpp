@@ -0,0 +1,266 @@
+#include <QtMath>
+#include <cstring>
+
+#include <QDebug>
+#include <QUrl>
+#include <QUrlQuery>
+
+#include "qsyntheticstream.h"
+
+namespace {
+
+// a stateless integer hash, so that noise doesn't depend on what was played before
+quint32 hash(quint32 x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+}
+
+double parameter(const QUrlQuery &query, const char *key, double defaultValue)
+{
+    bool ok = false;
+    const double value = query.queryItemValue(QLatin1String(key)).toDouble(&ok);
+    return ok ? value : defaultValue;
+}
+
+} // namespace
+
+QSyntheticStream::QSyntheticStream(const QString &name, const QAudioFormat &format)
+    : m_format(format)
+    , m_kernels(qMixerFormatKernels(format))
+    , m_frameBytes(format.bytesPerFrame())
+    , m_waveform(Sine)
+    , m_frequency(440)
+    , m_amplitude(0.5f)
+    , m_seed(1)
+    , m_frames(0)
+    , m_state(QtMixer::Unknown)
+    , m_loops(0)
+    , m_remainingLoops(0)
+    , m_frame(0)
+{
+    const QUrl url(name);
+    const QString waveform = url.path();
+    if (waveform == QLatin1String("sine")) {
+        m_waveform = Sine;
+    } else if (waveform == QLatin1String("square")) {
+        m_waveform = Square;
+    } else if (waveform == QLatin1String("saw")) {
+        m_waveform = Saw;
+    } else if (waveform == QLatin1String("noise")) {
+        m_waveform = Noise;
+    } else if (waveform == QLatin1String("silence")) {
+        m_waveform = Silence;
+    } else {
+        qWarning() << "Unknown synthetic waveform" << name;
+        return;
+    }
+    if (!m_kernels.isValid() || !m_frameBytes) {
+        qWarning() << "Can't synthesise" << name << "in" << format;
+        return;
+    }
+
+    const QUrlQuery query(url);
+    m_frequency = parameter(query, "frequency", 440);
+    m_amplitude = float(parameter(query, "amplitude", 0.5));
+    m_seed = quint32(parameter(query, "seed", 1));
+    const double duration = parameter(query, "duration", 1000);
+    m_frames = duration > 0 ? qint64(duration * format.sampleRate() / 1000) : -1;
+    m_bus.resize(BusFrames * format.channelCount());
+
+    setOpenMode(QIODevice::ReadOnly);
+    m_state = QtMixer::Stopped;
+}
+
+bool QSyntheticStream::isValid() const
+{
+    return m_state != QtMixer::Unknown;
+}
+
+float QSyntheticStream::sample(qint64 frame) const
+{
+    double phase = m_frequency * double(frame) / m_format.sampleRate();
+    phase -= std::floor(phase);
+
+    switch (m_waveform) {
+    case Sine:
+        return m_amplitude * float(std::sin(2 * M_PI * phase));
+    case Square:
+        return phase < 0.5 ? m_amplitude : -m_amplitude;
+    case Saw:
+        return m_amplitude * float(2 * phase - 1);
+    case Noise:
+        return m_amplitude * (float(hash(m_seed * 0x9e3779b9U + quint32(frame))) / 2147483648.0f - 1.0f);
+    case Silence:
+        break;
+    }
+    return 0.0f;
+}
+
+qint64 QSyntheticStream::readData(char *data, qint64 maxlen)
+{
+    if (m_state != QtMixer::Playing) {
+        memset(data, 0, maxlen);
+        return maxlen;
+    }
+
+    const qint64 n = render(data, maxlen);
+    memset(data + n, 0, maxlen - n);
+
+    return n;
+}
+
+qint64 QSyntheticStream::writeData(const char *data, qint64 len)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(len);
+
+    return 0;
+}
+
+qint64 QSyntheticStream::render(char *data, qint64 maxlen)
+{
+    if (m_state != QtMixer::Playing) {
+        return 0;
+    }
+
+    const qint64 maxFrames = maxlen / m_frameBytes;
+    const int channels = m_format.channelCount();
+    float *bus = m_bus.data();
+    qint64 frame = m_frame.load();
+    qint64 frames = 0;
+    while (frames < maxFrames) {
+        const qint64 wrap = loopWrapFrame(frame, m_frames, m_loops < 0 || m_remainingLoops > 1);
+        const qint64 end = wrap >= 0 ? wrap : m_frames;
+        qint64 n = maxFrames - frames;
+        if (end >= 0) {
+            n = qMax<qint64>(qMin(n, end - frame), 0);
+        }
+        for (qint64 done = 0; done < n;) {
+            const qint64 count = qMin<qint64>(n - done, BusFrames);
+            for (qint64 i = 0; i < count; ++i) {
+                const float value = sample(frame + done + i);
+                for (int c = 0; c < channels; ++c) {
+                    bus[i * channels + c] = value;
+                }
+            }
+            m_kernels.store(data + (frames + done) * m_frameBytes, bus, count * channels);
+            done += count;
+        }
+        frame += n;
+        frames += n;
+
+        if (frame == wrap) {
+            // carry on from the loop start within the same block
+            frame = loopStart();
+            if (m_loops > 0) {
+                --m_remainingLoops;
+            }
+        } else if (!n) {
+            break;
+        }
+    }
+    m_frame.storeRelease(frame);
+
+    return frames * m_frameBytes;
+}
+
+bool QSyntheticStream::atEnd() const
+{
+    return m_state == QtMixer::Unknown
+           || (m_frames >= 0 && m_frame.loadAcquire() >= m_frames);
+}
+
+bool QSyntheticStream::done() const
+{
+    // nothing to decode
+    return m_state != QtMixer::Unknown;
+}
+
+void QSyntheticStream::play()
+{
+    if (m_state != QtMixer::Unknown) {
+        m_state = QtMixer::Playing;
+
+        emit stateChanged(handle(), state());
+    }
+}
+
+void QSyntheticStream::pause()
+{
+    if (m_state == QtMixer::Playing) {
+        m_state = QtMixer::Paused;
+
+        emit stateChanged(handle(), state());
+    }
+}
+
+void QSyntheticStream::stop()
+{
+    if (m_state != QtMixer::Unknown && m_state != QtMixer::Stopped) {
+        m_state = QtMixer::Stopped;
+        m_remainingLoops = m_loops;
+        m_frame.storeRelease(0);
+
+        emit stateChanged(handle(), state());
+    }
+}
+
+QtMixer::State QSyntheticStream::state() const
+{
+    return QtMixer::State(m_state.loadAcquire());
+}
+
+int QSyntheticStream::loops() const
+{
+    return m_loops;
+}
+
+void QSyntheticStream::setLoops(int loops)
+{
+    m_loops = loops;
+    m_remainingLoops = loops;
+}
+
+int QSyntheticStream::position() const
+{
+    const qint64 frame = framePosition();
+    return frame >= 0 ? int(frame * 1000 / m_format.sampleRate()) : -1;
+}
+
+void QSyntheticStream::setPosition(int position)
+{
+    setFramePosition(qint64(position) * m_format.sampleRate() / 1000);
+}
+
+int QSyntheticStream::length()
+{
+    const qint64 frames = frameLength();
+    return frames >= 0 ? int(frames * 1000 / m_format.sampleRate()) : -1;
+}
+
+qint64 QSyntheticStream::framePosition() const
+{
+    return m_state != QtMixer::Unknown ? m_frame.loadAcquire() : -1;
+}
+
+void QSyntheticStream::setFramePosition(qint64 frame)
+{
+    if (m_state != QtMixer::Unknown) {
+        frame = qMax<qint64>(0, frame);
+        if (m_frames >= 0) {
+            frame = qMin(frame, m_frames);
+        }
+        m_frame.storeRelease(frame);
+    }
+}
+
+qint64 QSyntheticStream::frameLength()
+{
+    // infinite sources have no length
+    return m_state != QtMixer::Unknown ? m_frames : -1;
+}
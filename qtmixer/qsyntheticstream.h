@@ -0,0 +1,88 @@
+#ifndef QSYNTHETICSTREAM_H
+#define QSYNTHETICSTREAM_H
+
+#include <QAudioFormat>
+#include <QVector>
+
+#include "qabstractmixerstream.h"
+#include "qmixerformat_p.h"
+
+// Generates a test signal instead of playing a file, for testing and
+// benchmarking the mixer without any decoder or file I/O. Every sample is a
+// pure function of its frame number, so the output is the same on every run
+// and after any seek. The signal is described by a name of the form
+//   synth:<waveform>?frequency=440&amplitude=0.5&duration=1000&seed=1
+// where the waveform is sine, square, saw, noise or silence, the duration
+// is in milliseconds (0 for an endless signal) and the seed only matters for
+// noise. All parameters are optional; the values above are the defaults.
+class QTMIXER_EXPORT QSyntheticStream : public QAbstractMixerStream
+{
+public:
+    enum Waveform {
+        Sine,
+        Square,
+        Saw,
+        Noise,
+        Silence
+    };
+
+    QSyntheticStream(const QString &name, const QAudioFormat &format);
+
+    // false for an unknown waveform or an output format we can't write
+    bool isValid() const;
+
+    bool atEnd() const override;
+    bool done() const override;
+
+    void play() override;
+    void pause() override;
+    void stop() override;
+
+    QtMixer::State state() const override;
+
+    int loops() const override;
+    void setLoops(int loops) override;
+
+    int position() const override;
+    void setPosition(int position) override;
+
+    int length() override;
+
+    qint64 framePosition() const override;
+    void setFramePosition(qint64 frame) override;
+    qint64 frameLength() override;
+
+    qint64 render(char *data, qint64 maxlen) override;
+
+protected:
+    qint64 readData(char *data, qint64 maxlen) override;
+    qint64 writeData(const char *data, qint64 len) override;
+
+private:
+    enum {
+        // frames generated per pass through m_bus
+        BusFrames = 1024
+    };
+
+    float sample(qint64 frame) const;
+
+    QAudioFormat m_format;
+    QMixerFormatKernels m_kernels;
+    int m_frameBytes;
+    Waveform m_waveform;
+    double m_frequency;
+    float m_amplitude;
+    quint32 m_seed;
+    // -1 when endless
+    qint64 m_frames;
+    // allocated up front, so that rendering never allocates
+    QVector<float> m_bus;
+
+    QAtomicInt m_state;
+    QAtomicInt m_loops;
+    int m_remainingLoops;
+    // the play position, only ever changed by the mixing thread
+    QAtomicInteger<qint64> m_frame;
+};
+
+#endif // QSYNTHETICSTREAM_H
@@ -2,6 +2,7 @@
 #define QTMIXERGLOBAL_H
 
 #include <QtCore/QtGlobal>
+#include <QtCore/QMetaType>
 
 #ifdef BUILD_QTMIXER_WITH_QMAKE
 #if defined QTMIXER_LIBRARY
@@ -21,6 +22,37 @@ namespace QtMixer
         Stopped,
         Unknown
     };
+
+    enum MixMode {
+        // add the streams directly in the output format, clipping at every addition
+        SaturatingMix,
+        // add the streams on a 32 bit float bus and clip only once, when
+        // converting the sum to the output format
+        FloatMix
+    };
+
+    enum DecodeMode {
+        // decode the whole file into memory; best for short sounds that are
+        // looped or played over and over
+        CachedDecode,
+        // keep only a short window of decoded audio ahead of the play cursor;
+        // for long tracks. Seeking restarts the decoder.
+        StreamingDecode
+    };
+
+    // which playing stream makes room when one more is played than the
+    // mixer's maxVoices() allows; streams with a higher priority than the
+    // newcomer are never taken
+    enum StealPolicy {
+        // the one that has been playing longest
+        StealOldest,
+        // the one with the lowest RMS level in the last block mixed
+        StealQuietest,
+        // the one with the lowest priority, the oldest of those
+        StealLowestPriority
+    };
 }
 
+Q_DECLARE_METATYPE(QtMixer::State)
+
 #endif // QTMIXERGLOBAL_H
@@ -7,22 +7,53 @@ TARGET = $$qtLibraryTarget(QtMixer)
 VER_MAJ = 2
 
 SOURCES += \
+	qabstractmixerstream.cpp \
 	qaudiodecoderstream.cpp \
 	qmixerstream.cpp \
+	qmixerkernels.cpp \
+	qmixerformat.cpp \
+	qmixerlimiter.cpp \
+	qmixerringbuffer.cpp \
+	qmixerrenderthread.cpp \
+	qmixersamplebuffer.cpp \
+	qmixersamplebank.cpp \
+	qmixerdiskcache.cpp \
+	qmixerdecodepool.cpp \
+	qmixerstreamdecoder.cpp \
+	qpcmfilestream.cpp \
+	qsyntheticstream.cpp \
+	qmixerbackend.cpp \
 	qmixerstreamhandle.cpp \
 	qmixerstream_p.cpp
 
 INSTALL_HEADERS += \
 	qmixerstream.h \
 	qmixerstreamhandle.h \
+	qmixerbackend.h \
+	qmixerinsert.h \
 	qtmixer.h \
 	QMixerStream \
-	QMixerStreamhandle
+	QMixerStreamhandle \
+	QMixerBackend \
+	QMixerInsert
 
 PRIVATE_HEADERS += \
 	qaudiodecoderstream.h \
 	qabstractmixerstream.h \
-	qmixerstream_p.h
+	qpcmfilestream.h \
+	qsyntheticstream.h \
+	qmixerstream_p.h \
+	qmixerkernels_p.h \
+	qmixerformat_p.h \
+	qmixerringbuffer_p.h \
+	qmixerrenderthread_p.h \
+	qmixercommandqueue_p.h \
+	qmixerlimiter_p.h \
+	qmixersamplebuffer_p.h \
+	qmixersamplebank_p.h \
+	qmixerdiskcache_p.h \
+	qmixerdecodepool_p.h \
+	qmixerstreamdecoder_p.h
 
 HEADERS = \
 	$${INSTALL_HEADERS} \